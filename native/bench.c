@@ -0,0 +1,206 @@
+/* Benchmark driver for the R independent parser core (rjson/src/jsoncore.c).
+
+   Usage: bench [-n iterations] [file.json ...]
+
+   Each file (or, without files, a generated document of records) is validated with skipJSONValue,
+   turned into a tape with buildJSONTape, has every string unescaped and escaped again, and is base64
+   encoded and decoded, and the throughput of each pass is reported. Build with "make bench", and profile with e.g.
+   "perf record ./bench big.json". */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "jsoncore.h"
+
+typedef struct Buffer
+{
+	char* data;
+	size_t size;
+} Buffer;
+
+char* reserveBuffer( void* ctx, size_t size )
+{
+	Buffer* buf = (Buffer*)ctx;
+	if( size > buf->size ) {
+		size_t new_size = 2 * buf->size > size ? 2 * buf->size : size;
+		char* data = (char*)realloc( buf->data, new_size );
+		if( data == NULL )
+			return NULL;
+		buf->data = data;
+		buf->size = new_size;
+	}
+	return buf->data;
+}
+
+double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+char* readFile( const char* path, size_t* len )
+{
+	FILE* f = fopen( path, "rb" );
+	if( f == NULL ) {
+		perror( path );
+		exit( 1 );
+	}
+	fseek( f, 0, SEEK_END );
+	*len = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	char* text = (char*)malloc( *len + 1 );
+	if( text == NULL || fread( text, 1, *len, f ) != *len ) {
+		fprintf( stderr, "unable to read %s\n", path );
+		exit( 1 );
+	}
+	text[*len] = '\0';
+	fclose( f );
+	return text;
+}
+
+/* an array of records with a mix of numbers, ASCII and escaped strings, and nested arrays */
+char* generateDocument( size_t target, size_t* len )
+{
+	size_t size = target + 4096;
+	char* text = (char*)malloc( size );
+	size_t n = 0;
+	text[n++] = '[';
+	for( int i = 0; n < target; i++ ) {
+		n += snprintf( text + n,
+					   size - n,
+					   "%s{\"id\":%d,\"score\":%.6f,\"name\":\"user %d\",\"bio\":\"caf\xc3\xa9 \\u00e9 "
+					   "line\\nbreak \\\"quoted\\\"\",\"tags\":[\"a\",\"b\",%d],\"ok\":%s,\"x\":null}",
+					   i ? "," : "",
+					   i,
+					   i * 0.37,
+					   i,
+					   i % 7,
+					   i % 2 ? "true" : "false" );
+	}
+	text[n++] = ']';
+	text[n] = '\0';
+	*len = n;
+	return text;
+}
+
+void report( const char* name, size_t bytes, int iterations, double seconds )
+{
+	printf( "  %-10s %8.1f MB/s\n", name, bytes * (double)iterations / seconds / 1e6 );
+}
+
+int bench( const char* label, const char* text, size_t len, int iterations )
+{
+	Buffer scratch = { NULL, 0 };
+	Buffer escaped = { NULL, 0 };
+	JSONStringOptions options = { UNEXPECTED_ESCAPE_ERROR, INVALID_UTF8_ERROR, reserveBuffer, NULL, &scratch, NULL };
+	JSONTape tape = { NULL, 0, 0, 0 };
+	JSONError err;
+	const char* next_ch;
+	size_t string_bytes = 0;
+	double start;
+
+	printf( "%s: %lu bytes\n", label, (unsigned long)len );
+
+	start = now();
+	for( int i = 0; i < iterations; i++ ) {
+		if( skipJSONValue( text, &next_ch, &err ) != JSON_OK ) {
+			printf( "  invalid: %s", err.message );
+			return 1;
+		}
+	}
+	report( "skip", len, iterations, now() - start );
+
+	start = now();
+	for( int i = 0; i < iterations; i++ ) {
+		tape.n_nodes = 0;
+		if( buildJSONTape( text, &next_ch, &tape, &options, &err ) != JSON_OK ) {
+			printf( "  invalid: %s", err.message );
+			return 1;
+		}
+	}
+	report( "tape", len, iterations, now() - start );
+
+	/* the strings are the keys and scalar values of the containers on the tape */
+	size_t* children = (size_t*)malloc( ( tape.n_values + 1 ) * sizeof( size_t ) );
+	start = now();
+	for( int i = 0; i < iterations; i++ ) {
+		for( ptrdiff_t k = 0; k < tape.n_nodes; k++ ) {
+			const JSONTapeNode* node = &tape.nodes[k];
+			int is_object = text[node->offset] == '{';
+			if( !is_object && text[node->offset] != '[' )
+				continue;
+			getJSONTapeChildren( text, &tape, k, children );
+			for( ptrdiff_t c = 0; c < node->length; c++ ) {
+				const char* s = text + children[c];
+				size_t n;
+				if( is_object ) {
+					unescapeJSONString( s, &next_ch, &options, &n, &err );
+					s = skipJSONKey( s );
+				}
+				if( *s != '"' )
+					continue;
+				unescapeJSONString( s, &next_ch, &options, &n, &err );
+				if( reserveBuffer( &escaped, JSON_ESCAPED_SIZE( n ) ) == NULL ||
+					escapeJSONString( scratch.data, escaped.data ) < 0 ) {
+					printf( "  unable to escape string\n" );
+					return 1;
+				}
+				if( i == 0 )
+					string_bytes += next_ch - s;
+			}
+		}
+	}
+	report( "strings", string_bytes, iterations, now() - start );
+	free( children );
+
+	char* encoded = (char*)malloc( JSON_BASE64_SIZE( len ) );
+	unsigned char* decoded = (unsigned char*)malloc( len );
+	size_t encoded_len = 0;
+	start = now();
+	for( int i = 0; i < iterations; i++ )
+		encoded_len = encodeBase64( (const unsigned char*)text, len, encoded );
+	report( "base64 enc", len, iterations, now() - start );
+	start = now();
+	for( int i = 0; i < iterations; i++ ) {
+		if( decodeBase64( encoded, encoded_len, decoded ) != (ptrdiff_t)len ) {
+			printf( "  base64 does not round trip\n" );
+			return 1;
+		}
+	}
+	report( "base64 dec", len, iterations, now() - start );
+	free( encoded );
+	free( decoded );
+	printf( "  %ld values, %ld arrays and objects\n", (long)tape.n_values, (long)tape.n_nodes );
+
+	freeJSONTape( &tape );
+	free( scratch.data );
+	free( escaped.data );
+	return 0;
+}
+
+int main( int argc, char** argv )
+{
+	int iterations = 10;
+	int rc = 0;
+	int i = 1;
+	size_t len;
+
+	if( argc > 2 && strcmp( argv[1], "-n" ) == 0 ) {
+		iterations = atoi( argv[2] );
+		i = 3;
+	}
+	if( i == argc ) {
+		char* text = generateDocument( 64 * 1024 * 1024, &len );
+		rc = bench( "generated records", text, len, iterations );
+		free( text );
+	}
+	for( ; i < argc; i++ ) {
+		char* text = readFile( argv[i], &len );
+		rc |= bench( argv[i], text, len, iterations );
+		free( text );
+	}
+	return rc;
+}
@@ -0,0 +1,200 @@
+/* Fuzzing driver for the R independent parser core (rjson/src/jsoncore.c).
+
+   Built with libFuzzer by "make fuzz" (requires clang), or by "make check" as a plain program which
+   runs every file named on its command line (e.g. the seed corpus) under AddressSanitizer and
+   UndefinedBehaviorSanitizer. Besides memory errors, it checks that the scanners agree with each
+   other, that every string that can be unescaped can be escaped again, that base64 round
+   trips, and that MessagePack items are scanned within their bounds. */
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jsoncore.h"
+
+typedef struct Buffer
+{
+	char* data;
+	size_t size;
+} Buffer;
+
+char* reserveBuffer( void* ctx, size_t size )
+{
+	Buffer* buf = (Buffer*)ctx;
+	if( size > buf->size ) {
+		char* data = (char*)realloc( buf->data, size );
+		if( data == NULL )
+			return NULL;
+		buf->data = data;
+		buf->size = size;
+	}
+	return buf->data;
+}
+
+/* if s is a string, unescapes it (which must succeed, as the tape validated it) and escapes it again */
+void checkString( const char* s, const JSONStringOptions* options, Buffer* scratch )
+{
+	const char* next_ch;
+	JSONError err;
+	size_t n;
+	if( *s != '"' )
+		return;
+	if( unescapeJSONString( s, &next_ch, options, &n, &err ) != JSON_OK )
+		abort();
+	/* strings with embedded NULs (from \u0000) are cut short, as they are by R */
+	char* escaped = (char*)malloc( JSON_ESCAPED_SIZE( n ) );
+	if( escapeJSONString( scratch->data, escaped ) < 0 )
+		abort();
+	free( escaped );
+}
+
+int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size )
+{
+	static const int invalid_utf8[] = { INVALID_UTF8_ERROR, INVALID_UTF8_REPLACE, INVALID_UTF8_SKIP };
+	char* text = (char*)malloc( size + 1 );
+	memcpy( text, data, size );
+	text[size] = '\0';
+
+	for( int pass = 0; pass < 3; pass++ ) {
+		Buffer scratch = { NULL, 0 };
+		JSONStringOptions options = {
+			UNEXPECTED_ESCAPE_KEEP, invalid_utf8[pass], reserveBuffer, NULL, &scratch, NULL
+		};
+		JSONTape tape = { NULL, 0, 0, 0 };
+		JSONError err;
+		const char* skip_end = NULL;
+		const char* tape_end = NULL;
+
+		int skip_rc = skipJSONValue( text, &skip_end, &err );
+		int tape_rc = buildJSONTape( text, &tape_end, &tape, &options, &err );
+
+		/* the tape validates more than skipping does, but never less */
+		if( tape_rc == JSON_OK && ( skip_rc != JSON_OK || skip_end != tape_end ) )
+			abort();
+
+		if( tape_rc == JSON_OK ) {
+			for( ptrdiff_t k = 0; k < tape.n_nodes; k++ ) {
+				const JSONTapeNode* node = &tape.nodes[k];
+				if( node->next <= k || node->next > tape.n_nodes || node->offset >= node->end || node->end > size )
+					abort();
+				if( text[node->offset] != '[' && text[node->offset] != '{' ) {
+					/* only a scalar top level value has a node of its own */
+					if( k != 0 || tape.n_nodes != 1 )
+						abort();
+					checkString( text + node->offset, &options, &scratch );
+					continue;
+				}
+				size_t* children = (size_t*)malloc( ( node->length + 1 ) * sizeof( size_t ) );
+				ptrdiff_t container = k + 1;
+				getJSONTapeChildren( text, &tape, k, children );
+				for( ptrdiff_t i = 0; i < node->length; i++ ) {
+					const char* value = text + children[i];
+					if( children[i] <= node->offset || children[i] >= node->end )
+						abort();
+					if( text[node->offset] == '{' ) {
+						if( *value != '"' )
+							abort();
+						checkString( value, &options, &scratch );
+						value = skipJSONKey( value );
+					}
+					if( *value == '[' || *value == '{' ) {
+						/* nested containers are the following nodes, in order */
+						if( container >= node->next || text + tape.nodes[container].offset != value )
+							abort();
+						container = tape.nodes[container].next;
+					}
+					else
+						checkString( value, &options, &scratch );
+				}
+				if( container != node->next )
+					abort();
+				free( children );
+			}
+		}
+		freeJSONTape( &tape );
+		free( scratch.data );
+	}
+
+	/* base64 round trips, and decoding arbitrary text stays within its computed size */
+	char* encoded = (char*)malloc( JSON_BASE64_SIZE( size ) + 1 );
+	unsigned char* decoded = (unsigned char*)malloc( size + 1 );
+	size_t encoded_len = encodeBase64( data, size, encoded );
+	if( encoded_len != JSON_BASE64_SIZE( size ) || base64DecodedSize( encoded, encoded_len ) != size ||
+		decodeBase64( encoded, encoded_len, decoded ) != (ptrdiff_t)size ||
+		memcmp( decoded, data, size ) != 0 )
+		abort();
+	ptrdiff_t n = decodeBase64( text, size, decoded );
+	if( n >= 0 && (size_t)n != base64DecodedSize( text, size ) )
+		abort();
+	free( encoded );
+	free( decoded );
+
+	/* MessagePack: walk the items, counting those which containers still expect, and check that
+	   numbers read back exactly as they are written */
+	const unsigned char* s = data;
+	size_t pending = 1;
+	while( pending > 0 && s < data + size ) {
+		MsgPackItem item, again;
+		const unsigned char* next;
+		unsigned char out[MSGPACK_MAX_HEADER];
+		JSONError err;
+		if( scanMsgPackItem( s, data + size, &next, &item, &err ) != JSON_OK )
+			break;
+		if( next <= s || next > data + size )
+			abort();
+		if( ( item.type == MSGPACK_STRING || item.type == MSGPACK_BINARY ) &&
+			item.data + item.length != next )
+			abort();
+		if( item.type == MSGPACK_UNSIGNED && item.u.unsigned_integer <= LLONG_MAX )
+			abort();
+		if( item.type == MSGPACK_INTEGER || item.type == MSGPACK_FLOAT ) {
+			size_t n = item.type == MSGPACK_INTEGER ? writeMsgPackInteger( item.u.integer, out )
+												   : writeMsgPackDouble( item.u.number, out );
+			if( scanMsgPackItem( out, out + n, &next, &again, &err ) != JSON_OK || next != out + n )
+				abort();
+			if( item.type == MSGPACK_INTEGER ? again.u.integer != item.u.integer
+											 : memcmp( &again.u.number, &item.u.number, sizeof( double ) ) != 0 )
+				abort();
+		}
+		pending--;
+		/* every element takes at least a byte, so longer containers are truncated anyway */
+		if( item.length > size )
+			break;
+		if( item.type == MSGPACK_ARRAY )
+			pending += item.length;
+		if( item.type == MSGPACK_MAP )
+			pending += 2 * item.length;
+		s = next;
+	}
+
+	free( text );
+	return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+int main( int argc, char** argv )
+{
+	for( int i = 1; i < argc; i++ ) {
+		FILE* f = fopen( argv[i], "rb" );
+		if( f == NULL ) {
+			perror( argv[i] );
+			return 1;
+		}
+		fseek( f, 0, SEEK_END );
+		size_t size = ftell( f );
+		fseek( f, 0, SEEK_SET );
+		uint8_t* data = (uint8_t*)malloc( size );
+		if( fread( data, 1, size, f ) != size ) {
+			fprintf( stderr, "unable to read %s\n", argv[i] );
+			return 1;
+		}
+		fclose( f );
+		LLVMFuzzerTestOneInput( data, size );
+		free( data );
+	}
+	printf( "%d inputs ok\n", argc - 1 );
+	return 0;
+}
+#endif
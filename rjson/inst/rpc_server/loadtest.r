@@ -0,0 +1,74 @@
+#local load generator for the JSON-RPC server
+#usage: Rscript loadtest.r [requests] [burst size] [single|batch]
+#starts server.r with its stdin and stdout connected to named pipes, sends bursts of small calls,
+#waits for every response of a burst, then reports requests/s and the p50/p99 latency
+library( "rjson" )
+
+args <- commandArgs( trailingOnly = TRUE )
+n_requests <- if( length( args ) >= 1 ) as.integer( args[ 1 ] ) else 10000
+burst <- if( length( args ) >= 2 ) as.integer( args[ 2 ] ) else 50
+batch <- length( args ) >= 3 && args[ 3 ] == "batch"
+
+now <- function() as.numeric( Sys.time() )
+
+#the server is expected next to this script
+script <- sub( "^--file=", "", grep( "^--file=", commandArgs( FALSE ), value = TRUE ) )
+server_dir <- if( length( script ) == 1 ) dirname( normalizePath( script ) ) else getwd()
+
+fifo_dir <- tempfile( "rjson_loadtest" )
+dir.create( fifo_dir )
+request_fifo <- file.path( fifo_dir, "requests" )
+response_fifo <- file.path( fifo_dir, "responses" )
+if( system2( "mkfifo", c( shQuote( request_fifo ), shQuote( response_fifo ) ) ) != 0 )
+	stop( "unable to create named pipes" )
+
+system( sprintf( "cd %s && R_SERVER_SOURCE=some_script.r Rscript server.r < %s > %s",
+		shQuote( server_dir ), shQuote( request_fifo ), shQuote( response_fifo ) ), wait = FALSE )
+
+#the server's shell opens the request pipe first, then the response pipe
+requests <- file( request_fifo, open = "wb" )
+reader <- newJSONReader( response_fifo )
+
+sent <- numeric( n_requests )
+latency <- numeric( n_requests )
+start <- now()
+next_id <- 0
+while( next_id < n_requests ) {
+	ids <- next_id + seq_len( min( burst, n_requests - next_id ) )
+	calls <- sprintf( '{"jsonrpc": "2.0", "method": "user_func", "params": [1], "id": %d}', ids )
+	if( batch )
+		payload <- paste( "[", paste( calls, collapse = "," ), "]\n", sep = "" )
+	else
+		payload <- paste( calls, "\n", sep = "", collapse = "" )
+
+	sent[ ids ] <- now()
+	writeBin( charToRaw( payload ), requests )
+	flush( requests )
+
+	received <- 0
+	while( received < length( ids ) ) {
+		frames <- readJSONFrames( reader )
+		if( is.null( frames ) )
+			stop( "the server exited" )
+		t <- now()
+		for( frame in frames ) {
+			#a batch comes back as an array of responses
+			responses <- if( is.null( names( frame ) ) ) frame else list( frame )
+			for( response in responses ) {
+				if( !is.null( response$error ) )
+					stop( "request failed: ", response$error$message )
+				latency[ response$id ] <- t - sent[ response$id ]
+				received <- received + 1
+			}
+		}
+	}
+	next_id <- next_id + length( ids )
+}
+elapsed <- now() - start
+
+close( requests )
+unlink( fifo_dir, recursive = TRUE )
+
+cat( sprintf( "%d %s requests in bursts of %d: %.2fs, %.0f requests/s, p50 %.3f ms, p99 %.3f ms\n",
+		n_requests, if( batch ) "batched" else "pipelined", burst, elapsed, n_requests / elapsed,
+		1000 * quantile( latency, 0.5, names = FALSE ), 1000 * quantile( latency, 0.99, names = FALSE ) ) )
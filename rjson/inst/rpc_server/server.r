@@ -10,77 +10,91 @@ if( source_files != "" ) {
 		source( s )
 }
 
-#rpc is an R object corresponding to the parsed JSON-RPC call
-#returns: a JSON string with the results or error
-do.rpc <- function( rpc )
+#maximum number of requests to handle before writing their responses
+MAX_PENDING_RESPONSES <- 1000
+
+#builds a JSON-RPC error object
+rpc.error <- function( code, message, id = NULL, data = NULL )
 {
-	rpc$params <- as.list( rpc$params )
+	error <- list( code = code, message = message )
+	if( !is.null( data ) )
+		error$data <- data
+	return( list( jsonrpc = "2.0", error = error, id = id ) )
+}
 
-	result <- try( do.call( rpc$method, rpc$params ), silent = TRUE )
+#rpc is an R object corresponding to a single parsed JSON-RPC call
+#returns: the response object, or NULL for notifications (calls without an id)
+do.rpc <- function( rpc )
+{
+	if( !is.list( rpc ) || is.null( names( rpc ) ) || !is.character( rpc$method ) || length( rpc$method ) != 1 )
+		return( rpc.error( -32600, "Invalid Request" ) )
 
-	if( class( result ) == "try-error" ) {
-		#TODO JSON-RPC defines several erorrs (call not found, invalid params, and server error)
-		#if a call exists but fails, I am sending a procedure not found - when really it was found 
-		#but had an internal error. the data contains the actual error from R
-		rpc_result <- list(
-				jsonrpc = "2.0",
-				error = list( code = -32601, message = "Procedure not found.", data = as.character( result ) ),
-				id = rpc$id
-				)
+	if( !exists( rpc$method, mode = "function" ) ) {
+		rpc_result <- rpc.error( -32601, "Method not found", rpc$id )
 	} else {
-		#RPC call suceeded
-		rpc_result <- list(
-				jsonrpc = "2.0",
-				result = result,
-				id = rpc$id
-				)
+		result <- try( do.call( rpc$method, as.list( rpc$params ) ), silent = TRUE )
+		if( inherits( result, "try-error" ) ) {
+			#the data contains the actual error from R
+			rpc_result <- rpc.error( -32603, "Internal error", rpc$id, as.character( result ) )
+		} else {
+			#RPC call suceeded
+			rpc_result <- list(
+					jsonrpc = "2.0",
+					result = result,
+					id = rpc$id
+					)
+		}
 	}
 
-	#return the JSON string
-	ret <- toJSON( rpc_result )
-	ret <- paste( ret, "\n", sep="" )
-	return( ret )
+	if( !( "id" %in% names( rpc ) ) )
+		return( NULL )
+	return( rpc_result )
 }
 
-#requires R 2.5.0
-process_stdin <- file("stdin", blocking = T, open = "rb" )
-json_parser <- newJSONParser()
-
-while( TRUE ) {
-
-	#TODO read in data in larger chunks
-	#when n > 1, readBin sometimes waits until a complete block of n chars is read - piping a flush doesn't always work when n > 1
-	s <- readBin( process_stdin, what = raw(), n = 1 )
+#frame is a single parsed JSON value read from the input: either one call, or a batch (array) of calls
+#returns: a JSON string with the response(s), or NULL if nothing should be sent back
+do.frame <- function( frame )
+{
+	if( inherits( frame, "try-error" ) )
+		return( toJSON( rpc.error( -32700, "Parse error" ) ) )
 
-	#catch an OEF
-	if( length( s ) == 0 )
-		break
-	s <- rawToChar( s )
+	#a batch is an array, which is parsed into an unnamed list (or vector)
+	if( is.null( names( frame ) ) && length( frame ) > 0 ) {
+		responses <- lapply( as.list( frame ), do.rpc )
+		responses <- responses[ !sapply( responses, is.null ) ]
+		if( length( responses ) == 0 )
+			return( NULL )
+		#all responses of a batch are serialized into a single array
+		return( toJSON( responses ) )
+	}
 
-	#add input to parser buffer
-	json_parser$addData( s )
-	#Optimization: JSON RPC objects MUST terminate with a `}' - no need to check if the object can be parsed otherwise (since it can't)
-	while( s == "}" ) {
-		#try to extract any JSON objects
-		rpc <- try( json_parser$getObject(), silent = TRUE )
-		if( class( rpc ) == "try-error" ) {
-			#an error occured
-			cat( '{"jsonrpc": "2.0", "error": {"code": -32700, "message": "Parse error"}, "id": null}' )
-			#reset JSON parser
-			json_parser <- newJSONParser()
+	rpc_result <- do.rpc( frame )
+	if( is.null( rpc_result ) )
+		return( NULL )
+	return( toJSON( rpc_result ) )
+}
 
-			#clear anything on the input
-			seek( process_stdin, where = 0, origin = "end" )
+#read requests straight from the stdin file descriptor, in large chunks
+reader <- newJSONReader( 0L )
 
-		} else {
-			#not enough data is in the buffer to extract a complete JSON object	
-			if( is.null( rpc ) )
-				break
+#each iteration handles every complete request which has arrived; NULL signals the end of the input
+while( !is.null( requests <- readJSONFrames( reader ) ) ) {
+	responses <- character( 0 )
+	repeat {
+		for( frame in requests )
+			responses <- c( responses, do.frame( frame ) )
+		#drain any pipelined requests which arrived in the meantime, before writing
+		if( length( responses ) >= MAX_PENDING_RESPONSES )
+			break
+		requests <- readJSONFrames( reader, timeout = 0 )
+		if( length( requests ) == 0 )
+			break
+	}
 
-			#a valid JSON object was extracted
-			ret <- do.rpc( rpc )
-			cat( ret )
-		}
+	#write the responses back in one batch
+	if( length( responses ) > 0 ) {
+		cat( paste( responses, "\n", sep = "", collapse = "" ) )
+		flush( stdout() )
 	}
 }
 
@@ -36,3 +36,53 @@ test.array <- function()
 	checkIdentical( x, list( NULL, list() ) )
 }
 
+
+test.matrix <- function()
+{
+	x <- fromJSON( "[[1,2,3],[4,5,6]]", simplify = "matrix" )
+	checkIdentical( x, matrix( c(1,2,3,4,5,6), nrow = 2, byrow = TRUE ) )
+	checkIdentical( toJSON( x, matrix = "rowmajor" ), "[[1,2,3],[4,5,6]]" )
+
+	x <- fromJSON( "[[1,2],[3.5,4]]", simplify = "matrix", integer = TRUE )
+	checkIdentical( x, matrix( c(1,3.5,2,4), nrow = 2 ) )
+
+	x <- fromJSON( "[[\"a\",\"b\"],[\"c\",\"d\"]]", simplify = "matrix" )
+	checkIdentical( x, matrix( c("a","b","c","d"), nrow = 2, byrow = TRUE ) )
+
+	#the first dimension indexes the outermost array
+	x <- fromJSON( "[[[1,2],[3,4]],[[5,6],[7,8]]]", simplify = "matrix", integer = TRUE )
+	checkIdentical( x[2,1,2], 6L )
+	checkIdentical( toJSON( x, matrix = "rowmajor" ), "[[[1,2],[3,4]],[[5,6],[7,8]]]" )
+
+	#ragged or mixed arrays are not matrices
+	checkIdentical( fromJSON( "[[1,2],[3]]", simplify = "matrix" ), list( c(1,2), 3 ) )
+	checkIdentical( fromJSON( "[[1,2],[\"a\",\"b\"]]", simplify = "matrix" ), list( c(1,2), c("a","b") ) )
+	checkIdentical( fromJSON( "[[1,2],[3,4]]" ), list( c(1,2), c(3,4) ) )
+
+	#matrices are flattened by default
+	checkIdentical( toJSON( matrix( 1:4, nrow = 2 ) ), "[1,2,3,4]" )
+}
+
+test.null.na <- function()
+{
+	#nulls keep arrays typed
+	checkIdentical( fromJSON( "[1,null,2.5]", null = "NA" ), c(1,NA,2.5) )
+	checkIdentical( fromJSON( "[1,null,3]", null = "NA", integer = TRUE ), c(1L,NA,3L) )
+	checkIdentical( fromJSON( "[\"a\",null]", null = "NA" ), c("a",NA) )
+	checkIdentical( fromJSON( "[null,true]", null = "NA" ), c(NA,TRUE) )
+	checkIdentical( fromJSON( "[null,null]", null = "NA" ), c(NA,NA) )
+	checkIdentical( fromJSON( "[9007199254740993,null]", null = "NA", bigint = "string" ), c("9007199254740993",NA) )
+
+	#mixed arrays are still lists, with NA for null
+	checkIdentical( fromJSON( "[1,\"a\",null]", null = "NA" ), list(1,"a",NA) )
+	checkIdentical( fromJSON( "[null,[]]", null = "NA" ), list( NA, list() ) )
+	checkIdentical( fromJSON( "[1,null]", null = "NA", simplify = FALSE ), list(1,NA) )
+
+	#nulls outside of arrays
+	checkIdentical( fromJSON( "{\"a\":null}", null = "NA" ), list( a = NA ) )
+	checkIdentical( fromJSON( "null", null = "NA" ), NA )
+
+	#the default is unchanged
+	checkIdentical( fromJSON( "[1,null]" ), list(1,NULL) )
+	checkException( fromJSON( "[1]", null = "missing" ), silent = TRUE )
+}
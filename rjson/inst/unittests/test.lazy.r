@@ -0,0 +1,39 @@
+.setUp <- function() {}
+.tearDown <- function() {}
+
+test.lazy <- function()
+{
+	json <- '{"meta": {"n": 2}, "data": [1, {"name": "x"}, {"name": "y", "v": [1,2,3]}], "last": null}'
+	doc <- parseJSONLazy( json, integer = TRUE )
+	checkTrue( inherits( doc, "rjson_lazy" ) )
+	checkEquals( length( doc ), 3 )
+	checkIdentical( names( doc ), c( "meta", "data", "last" ) )
+	checkIdentical( doc[[ "data" ]][[ 1 ]], 1L )
+	checkIdentical( doc[[ "data" ]][[ 3 ]][[ "name" ]], "y" )
+	checkIdentical( doc$data[[ 2 ]]$name, "x" )
+	checkIdentical( names( doc$data ), NULL )
+	checkIdentical( doc[[ "missing" ]], NULL )
+	checkIdentical( doc[[ "last" ]], NULL )
+	checkException( doc$data[[ 4 ]], silent = TRUE )
+
+	#elements are found from the text, escaped quotes and nested values included
+	esc <- parseJSONLazy( '{"a\\"b": ["x]\\\\", {"c": [1]}, -2e3, true], "z": {}}' )
+	checkIdentical( names( esc ), c( "a\"b", "z" ) )
+	checkIdentical( esc[[ "a\"b" ]][[ 1 ]], "x]\\" )
+	checkIdentical( esc[[ 1 ]][[ 2 ]]$c[[ 1 ]], 1 )
+	checkIdentical( esc[[ 1 ]][[ 3 ]], -2000 )
+	checkIdentical( esc[[ 1 ]][[ 4 ]], TRUE )
+	checkEquals( length( esc$z ), 0 )
+	x <- parseJSONLazy( toJSON( 1:10000 ) )
+	checkIdentical( sapply( 1:10000, function( i ) x[[ i ]] ), as.numeric( 1:10000 ) )
+
+	#materialized values are the same as fromJSON's
+	checkIdentical( materializeJSON( doc$data[[ 3 ]]$v ), 1:3 )
+	checkIdentical( materializeJSON( doc ), fromJSON( json, integer = TRUE ) )
+	checkIdentical( materializeJSON( parseJSONLazy( '"a\\u0062"' ) ), "ab" )
+
+	#the whole document is validated up front
+	checkException( parseJSONLazy( '{"a": [1, "\\q"]}' ), silent = TRUE )
+	checkException( parseJSONLazy( '[1, 2] 3' ), silent = TRUE )
+	checkException( parseJSONLazy( '[1, {"a":' ), silent = TRUE )
+}
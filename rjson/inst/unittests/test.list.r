@@ -59,3 +59,34 @@ test.rejected.comma <- function()
 	x <- try( fromJSON( bad_json ), silent = TRUE )
 	checkTrue( any( class( x ) == "try-error" ) )
 }
+
+test.hashed.list <- function()
+{
+	json <- toJSON( setNames( as.list( 1:1000 ), paste0( "user", 1:1000 ) ) )
+	x <- fromJSON( json, hash.threshold = 100 )
+	checkTrue( inherits( x, "rjson_hashed" ) )
+	checkIdentical( x[[ "user500" ]], 500 )
+	checkIdentical( x[[ 500 ]], 500 )
+	checkIdentical( length( x ), 1000L )
+	checkTrue( is.null( x[[ "user0" ]] ) )
+	checkIdentical( toJSON( x ), json )
+	checkException( toJSON( new.env() ), silent = TRUE )
+
+	#smaller objects are still lists
+	x <- fromJSON( "{\"a\":{\"b\":1},\"c\":2}", hash.threshold = 2 )
+	checkTrue( inherits( x, "rjson_hashed" ) )
+	checkIdentical( x$a, list( b = 1 ) )
+	checkTrue( !inherits( fromJSON( "{\"a\":1}", hash.threshold = 1e300 ), "rjson_hashed" ) )
+	checkException( fromJSON( "{\"a\":1}", hash.threshold = NA ), silent = TRUE )
+
+	#keys are not symbols, so the empty key works; a repeated key keeps its last value
+	x <- fromJSON( "{\"\":1,\"b\":2,\"b\":3}", hash.threshold = 1 )
+	checkIdentical( names( x ), c( "", "b" ) )
+	checkIdentical( x[[ "" ]], 1 )
+	checkIdentical( x$b, 3 )
+
+	#renamed keys are still found
+	names( x )[ 1 ] <- "a"
+	checkIdentical( x[[ "a" ]], 1 )
+	checkTrue( is.null( x[[ "" ]] ) )
+}
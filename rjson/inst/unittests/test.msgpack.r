@@ -0,0 +1,65 @@
+.setUp <- function() {}
+.tearDown <- function() {}
+
+test.msgpack.json <- function()
+{
+	values <- list(
+		NULL, 1, 1:3, c( 1.5, NA, NaN, Inf, -Inf ), c( TRUE, NA ), c( "a", NA ), "caf\u00e9",
+		list(), list( a = 1, b = list( 2, "x" ), c = NULL ), c( x = 1, y = 2 ), list( list( 1, 2 ), list( 3, 4 ) ),
+		factor( c( "lo", "hi", "lo" ) ), matrix( 1:4, 2 ), complex( real = 1, imaginary = -2 ),
+		-c( 1, 33, 200, 70000, 3e9, 5e9 )
+	)
+	for( x in values ) {
+		checkIdentical( fromMsgPack( toMsgPack( x ) ), fromJSON( toJSON( x ) ) )
+		checkIdentical( fromMsgPack( toMsgPack( x ), simplify = FALSE ), fromJSON( toJSON( x ), simplify = FALSE ) )
+	}
+	x <- list( a = NULL, b = list( 1, NULL ) )
+	checkIdentical( fromMsgPack( toMsgPack( x ), null = "NA" ), fromJSON( toJSON( x ), null = "NA" ) )
+
+	x <- fromMsgPack( toMsgPack( list( a = 1, b = 2 ) ), hash.threshold = 1 )
+	checkTrue( inherits( x, "rjson_hashed" ) )
+	checkIdentical( fromMsgPack( toMsgPack( x ) ), list( a = 1, b = 2 ) )
+}
+
+test.msgpack.exact <- function()
+{
+	#doubles keep every bit, and only integers are read as integers
+	x <- c( pi, 1 / 3, 1e-300, 2^60 )
+	checkIdentical( fromMsgPack( toMsgPack( x ) ), x )
+	checkIdentical( fromMsgPack( toMsgPack( list( 1L, 2 ) ), integer = TRUE, simplify = FALSE ), list( 1L, 2 ) )
+	checkIdentical( fromMsgPack( toMsgPack( c( 1L, NA ) ), integer = TRUE ), list( 1L, "NA" ) )
+	checkIdentical( fromMsgPack( as.raw( c( 0xcf, 0x7f, rep( 0xff, 7 ) ) ), bigint = "string" ), "9223372036854775807" )
+	#uint 64 beyond the range of integer64, and NA_integer64_ itself, are exact only as strings
+	checkIdentical( fromMsgPack( as.raw( c( 0xcf, rep( 0xff, 8 ) ) ), bigint = "string" ), "18446744073709551615" )
+	checkIdentical( fromMsgPack( as.raw( c( 0xcf, rep( 0xff, 8 ) ) ) ), 2^64 )
+	checkIdentical( fromMsgPack( as.raw( c( 0xd3, 0x80, rep( 0, 7 ) ) ), bigint = "string" ), "-9223372036854775808" )
+	checkIdentical( fromMsgPack( as.raw( c( 0xd3, 0x80, rep( 0, 7 ) ) ), bigint = "string" ),
+					fromJSON( "-9223372036854775808", bigint = "string" ) )
+
+	x <- as.raw( c( 0, 1, 255 ) )
+	checkIdentical( fromMsgPack( toMsgPack( list( blob = x ) ) ), list( blob = x ) )
+}
+
+test.msgpack.bytes <- function()
+{
+	checkIdentical( toMsgPack( NULL ), as.raw( 0xc0 ) )
+	checkIdentical( toMsgPack( TRUE ), as.raw( 0xc3 ) )
+	checkIdentical( toMsgPack( 1L ), as.raw( 0x01 ) )
+	checkIdentical( toMsgPack( -200L ), as.raw( c( 0xd1, 0xff, 0x38 ) ) )
+	checkIdentical( toMsgPack( 1 ), as.raw( c( 0xcb, 0x3f, 0xf0, rep( 0, 6 ) ) ) )
+	checkIdentical( toMsgPack( "a" ), as.raw( c( 0xa1, 0x61 ) ) )
+	checkIdentical( toMsgPack( list( a = 1L ) ), as.raw( c( 0x81, 0xa1, 0x61, 0x01 ) ) )
+	checkIdentical( toMsgPack( list() ), as.raw( 0x90 ) )
+	checkIdentical( length( toMsgPack( rep( "x", 70000 ) ) ), 5L + 2L * 70000L )
+
+	checkIdentical( fromMsgPack( as.raw( c( 0xca, 0x3f, 0xc0, 0, 0 ) ) ), 1.5 )
+	checkException( fromMsgPack( raw(0) ), silent = TRUE )
+	checkException( fromMsgPack( as.raw( c( 0x92, 0x01 ) ) ), silent = TRUE )
+	checkException( fromMsgPack( as.raw( c( 0x01, 0x02 ) ) ), silent = TRUE )
+	checkException( fromMsgPack( as.raw( c( 0x81, 0x01, 0x02 ) ) ), silent = TRUE )
+	checkException( fromMsgPack( as.raw( c( 0xd4, 0x01, 0x02 ) ) ), silent = TRUE )
+	checkException( fromMsgPack( as.raw( c( 0xa1, 0xff ) ) ), silent = TRUE )
+	checkIdentical( fromMsgPack( as.raw( c( 0xa1, 0xff ) ), invalid.utf8 = "replace" ), "\ufffd" )
+	checkException( fromMsgPack( "x" ), silent = TRUE )
+	checkException( toMsgPack( new.env() ), silent = TRUE )
+}
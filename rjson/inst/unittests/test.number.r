@@ -44,3 +44,48 @@ test.number <- function()
 }
 
 
+
+test.integer <- function()
+{
+	checkIdentical( fromJSON( "[1,2,3]", integer = TRUE ), 1:3 )
+	checkIdentical( fromJSON( "5", integer = TRUE ), 5L )
+	checkIdentical( fromJSON( "[1,2.5]", integer = TRUE ), c( 1, 2.5 ) )
+	checkIdentical( fromJSON( "[1,3000000000]", integer = TRUE ), c( 1, 3e9 ) )
+	checkIdentical( fromJSON( "[1e3]", integer = TRUE ), 1000 )
+	checkIdentical( fromJSON( "[[1],[2]]", integer = TRUE ), 1:2 )
+	checkIdentical( fromJSON( "{\"a\":1,\"b\":1.5}", integer = TRUE ), list( a = 1L, b = 1.5 ) )
+	checkIdentical( fromJSON( "[1,2,3]" ), c( 1, 2, 3 ) )
+}
+
+test.bigint <- function()
+{
+	checkIdentical( fromJSON( "[1,9007199254740993]", bigint = "string" ), c( "1", "9007199254740993" ) )
+	checkIdentical( fromJSON( "{\"id\":-9223372036854775807}", bigint = "string" ), list( id = "-9223372036854775807" ) )
+	checkIdentical( fromJSON( "[1.5,9007199254740993]", bigint = "string" ), list( 1.5, "9007199254740993" ) )
+	#small numbers are unaffected
+	checkIdentical( fromJSON( "[1,2]", bigint = "string" ), c( 1, 2 ) )
+	#integers beyond 64 bits keep their digits
+	checkIdentical( fromJSON( "123456789012345678901234567890", bigint = "string" ), "123456789012345678901234567890" )
+	checkIdentical( fromJSON( "[1,-123456789012345678901234567890]", bigint = "string" ), c( "1", "-123456789012345678901234567890" ) )
+	checkIdentical( fromJSON( "{\"id\":123456789012345678901234567890,\"x\":1.5}", bigint = "string" ),
+		list( id = "123456789012345678901234567890", x = 1.5 ) )
+	checkIdentical( fromJSON( "123456789012345678901234567890", bigint = "integer64" ), 1.2345678901234568e29 )
+
+	x <- fromJSON( "[1,9007199254740993]", bigint = "integer64" )
+	checkTrue( inherits( x, "integer64" ) )
+	checkIdentical( toJSON( x ), "[1,9007199254740993]" )
+
+	x <- try( fromJSON( "1", bigint = "huge" ), silent = TRUE )
+	checkTrue( any( class( x ) == "try-error" ) )
+}
+
+test.options.method.R <- function()
+{
+	#options which only the C method implements are rejected rather than ignored by the R method
+	checkIdentical( fromJSON( "[1,2]", method = "R", integer = FALSE, bigint = "double" ), c( 1, 2 ) )
+	for( args in list( list( integer = TRUE ), list( bigint = "string" ), list( hash.threshold = 1 ),
+					   list( invalid.utf8 = "replace" ), list( null = "NA" ) ) ) {
+		x <- try( do.call( fromJSON, c( list( "[1,2]", method = "R" ), args ) ), silent = TRUE )
+		checkTrue( grepl( paste( names( args ), "is only supported by the C method" ), x ) )
+	}
+}
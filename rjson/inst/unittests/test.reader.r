@@ -0,0 +1,93 @@
+.setUp <- function() {}
+.tearDown <- function() {}
+
+test.reader <- function()
+{
+	con <- rawConnection( charToRaw( "{\"id\":1} {\"id\":2, \"x\":[1,2]}\n 12 [3]" ) )
+	reader <- newJSONReader( con )
+	x <- readJSONFrames( reader, integer = TRUE )
+	checkIdentical( x, list( list( id = 1L ), list( id = 2L, x = 1:2 ), 12L, 3L ) )
+	checkIdentical( readJSONFrames( reader ), NULL )
+	close( con )
+
+	#invalid objects are returned as errors
+	con <- rawConnection( charToRaw( "[1,] {\"a\":" ) )
+	reader <- newJSONReader( con )
+	x <- readJSONFrames( reader )
+	checkTrue( any( class( x[[ 1 ]] ) == "try-error" ) )
+	close( con )
+
+	#reading continues after an invalid object
+	con <- rawConnection( charToRaw( "{bad} {\"id\":3} [1,}[2]" ) )
+	reader <- newJSONReader( con )
+	x <- readJSONFrames( reader )
+	checkIdentical( length( x ), 4L )
+	checkIdentical( x[[ 2 ]], list( id = 3 ) )
+	checkIdentical( x[[ 4 ]], 2 )
+	close( con )
+}
+
+test.reader.file <- function()
+{
+	if( .Platform$OS.type == "windows" )
+		return()
+	path <- tempfile()
+	writeLines( c( "[{\"id\":1},{\"id\":2}]", "{\"id\":3}" ), path )
+	reader <- newJSONReader( path )
+	x <- readJSONFrames( reader, integer = TRUE )
+	checkIdentical( x, list( list( list( id = 1L ), list( id = 2L ) ), list( id = 3L ) ) )
+	checkIdentical( readJSONFrames( reader ), NULL )
+	unlink( path )
+}
+
+test.reader.pipe <- function()
+{
+	if( .Platform$OS.type == "windows" )
+		return()
+	#a complete object is returned without waiting for more output, and the timeout is honoured
+	con <- pipe( "printf '{\"id\":1} {\"id\"'; sleep 2; printf ':2}'" )
+	reader <- newJSONReader( con )
+	elapsed <- system.time( x <- readJSONFrames( reader, timeout = 1000, integer = TRUE ) )[[ "elapsed" ]]
+	checkIdentical( x, list( list( id = 1L ) ) )
+	checkTrue( elapsed < 1.5 )
+	checkIdentical( readJSONFrames( reader, timeout = 100 ), list() )
+	checkIdentical( readJSONFrames( reader, integer = TRUE ), list( list( id = 2L ) ) )
+	checkIdentical( readJSONFrames( reader ), NULL )
+}
+
+test.reader.socket <- function()
+{
+	if( !exists( "serverSocket" ) )
+		return()
+	port <- NULL
+	for( p in sample( 20000:40000, 10 ) ) {
+		server <- try( serverSocket( p ), silent = TRUE )
+		if( !inherits( server, "try-error" ) ) {
+			port <- p
+			break
+		}
+	}
+	if( is.null( port ) )
+		return()
+	client <- socketConnection( "localhost", port, open = "r+b" )
+	con <- socketAccept( server, open = "r+b" )
+	close( server )
+
+	writeBin( charToRaw( "{\"id\":1} {\"id\"" ), client )
+	reader <- newJSONReader( con )
+	checkIdentical( readJSONFrames( reader, timeout = 1000, integer = TRUE ), list( list( id = 1L ) ) )
+	elapsed <- system.time( x <- readJSONFrames( reader, timeout = 200 ) )[[ "elapsed" ]]
+	checkIdentical( x, list() )
+	checkTrue( elapsed < 1 )
+
+	#larger than one chunk
+	writeBin( charToRaw( paste0( ":2} [", paste( rep( "1", 50000 ), collapse = "," ), "]" ) ), client )
+	close( client )
+	x <- list()
+	for( i in 1:10 )
+		if( length( x ) < 2 )
+			x <- c( x, readJSONFrames( reader, integer = TRUE ) )
+	checkIdentical( x, list( list( id = 2L ), rep( 1L, 50000 ) ) )
+	checkIdentical( readJSONFrames( reader ), NULL )
+	close( con )
+}
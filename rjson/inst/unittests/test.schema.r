@@ -0,0 +1,65 @@
+.setUp <- function() {}
+.tearDown <- function() {}
+
+test.schema <- function()
+{
+	s <- compileJSONSchema( list( id = "integer", x = "numeric", name = "character", ok = "logical", tags = "character[]" ) )
+
+	x <- fromJSON( "{\"id\":5, \"x\":1.5, \"name\":\"a\", \"ok\":true, \"tags\":[\"b\",null]}", schema = s )
+	checkIdentical( x, list( id = 5L, x = 1.5, name = "a", ok = TRUE, tags = c( "b", NA ) ) )
+
+	#keys may come in any order, unknown keys are skipped, and missing keys become NA
+	x <- fromJSON( "{\"unknown\":{\"a\":[1,\"]\"]}, \"name\":\"z\", \"id\":1}", schema = s )
+	checkIdentical( x, list( id = 1L, x = NA_real_, name = "z", ok = NA, tags = NULL ) )
+
+	#arrays of records
+	x <- fromJSON( "[{\"id\":1},{\"id\":2}]", schema = s )
+	checkIdentical( sapply( x, function( r ) r$id ), c( 1L, 2L ) )
+
+	failing_json <- c( "{\"id\":1.5}", "{\"id\":\"1\"}", "{\"tags\":[1]}", "{\"ok\":1}", "{\"id\":1", "[1]" )
+	for( bad_json in failing_json ) {
+		x <- try( fromJSON( bad_json, schema = s ), silent = TRUE )
+		checkTrue( any( class( x ) == "try-error" ) )
+	}
+}
+
+test.schema.nested <- function()
+{
+	s <- compileJSONSchema( list( user = list( name = "character" ), items = list( list( v = "integer[]" ) ) ) )
+	x <- fromJSON( "{\"items\":[{\"v\":[1,2]},{\"v\":[]}], \"user\":{\"name\":\"u\",\"age\":3}}", schema = s )
+	checkIdentical( x, list( user = list( name = "u" ), items = list( list( v = 1:2 ), list( v = integer(0) ) ) ) )
+}
+
+test.schema.posixct <- function()
+{
+	s <- compileJSONSchema( list( ts = "POSIXct" ) )
+	expected <- as.POSIXct( "2020-01-02 03:04:05", tz = "UTC" )
+	checkEquals( fromJSON( "{\"ts\":\"2020-01-02T03:04:05Z\"}", schema = s )$ts, expected )
+	checkEquals( fromJSON( "{\"ts\":\"2020-01-02T04:04:05+01:00\"}", schema = s )$ts, expected )
+	checkEquals( fromJSON( sprintf( "{\"ts\":%.0f}", as.numeric( expected ) ), schema = s )$ts, expected )
+}
+
+test.schema.raw <- function()
+{
+	s <- compileJSONSchema( list( blob = "raw", blobs = "raw[]" ) )
+	for( n in c( 0, 1, 2, 3, 4, 1000 ) ) {
+		x <- list( blob = as.raw( seq_len( n ) %% 256 ), blobs = list( as.raw( 255 ), raw(0) ) )
+		checkIdentical( fromJSON( toJSON( x ), schema = s ), x )
+	}
+	checkIdentical( toJSON( charToRaw( "foobar" ) ), "\"Zm9vYmFy\"" )
+	checkIdentical( toJSON( list( charToRaw( "f" ), 1 ) ), "[\"Zg==\",1]" )
+
+	#padding is optional
+	checkIdentical( fromJSON( "{\"blob\":\"Zg\"}", schema = s )$blob, charToRaw( "f" ) )
+	checkIdentical( fromJSON( "{\"blob\":null}", schema = s ), list( blob = NULL, blobs = NULL ) )
+	checkException( fromJSON( "{\"blob\":\"Zm9v=YmFy\"}", schema = s ), silent = TRUE )
+	checkException( fromJSON( "{\"blob\":1}", schema = s ), silent = TRUE )
+}
+
+test.schema.invalid <- function()
+{
+	x <- try( compileJSONSchema( list( a = "unknown" ) ), silent = TRUE )
+	checkTrue( any( class( x ) == "try-error" ) )
+	x <- try( fromJSON( "{}", schema = list( a = "integer" ) ), silent = TRUE )
+	checkTrue( any( class( x ) == "try-error" ) )
+}
@@ -0,0 +1,73 @@
+.setUp <- function() {}
+.tearDown <- function() {}
+
+.writeGz <- function( lines )
+{
+	path <- tempfile( fileext = ".json.gz" )
+	con <- gzfile( path, "w" )
+	writeLines( lines, con )
+	close( con )
+	return( path )
+}
+
+test.stream.file <- function()
+{
+	#large enough to span many decompressed chunks
+	x <- lapply( 1:20000, function( i ) list( id = i, name = paste( "user", i ), v = c( i, i / 2 ) ) )
+	json <- toJSON( x )
+	path <- .writeGz( json )
+	checkIdentical( fromJSON( file = path ), fromJSON( json ) )
+	unlink( path )
+
+	path <- .writeGz( c( "{\"a\": [1, 2],", " \"b\": {\"c\": \"d\"} }" ) )
+	checkIdentical( fromJSON( file = path ), list( a = c( 1, 2 ), b = list( c = "d" ) ) )
+	unlink( path )
+
+	for( bad_json in c( "[1,2", "[1,2] 3", "{\"a\" 1}" ) ) {
+		path <- .writeGz( bad_json )
+		x <- try( fromJSON( file = path ), silent = TRUE )
+		checkTrue( any( class( x ) == "try-error" ) )
+		unlink( path )
+	}
+}
+
+test.stream.ndjson <- function()
+{
+	path <- .writeGz( c( "{\"id\":1,\"name\":\"a\"}", "", "{\"id\":2}", "{bad}" ) )
+	x <- try( fromNDJSON( path ), silent = TRUE )
+	checkTrue( grepl( "line 4", x ) )
+
+	x <- fromNDJSON( path, integer = TRUE, invalid = "NA" )
+	checkIdentical( x, list( list( id = 1L, name = "a" ), list( id = 2L ), NA ) )
+
+	x <- fromNDJSON( path, integer = TRUE, invalid = "NA", output = "data.frame" )
+	checkIdentical( x$id, c( 1L, 2L, NA ) )
+	checkIdentical( x$name, c( "a", NA, NA ) )
+	unlink( path )
+}
+
+test.stream.async <- function()
+{
+	x <- lapply( 1:20000, function( i ) list( id = i, name = paste( "user", i ), v = c( i, i / 2 ) ) )
+	json <- toJSON( x )
+	path <- .writeGz( json )
+	h <- fromJSONAsync( path )
+	checkIdentical( asyncJSONValue( h ), fromJSON( json ) )
+	#the result is kept
+	checkIdentical( asyncJSONValue( h ), fromJSON( json ) )
+	unlink( path )
+
+	path <- .writeGz( "[1, null, 3]" )
+	checkIdentical( asyncJSONValue( fromJSONAsync( path, null = "NA", integer = TRUE ) ), c( 1L, NA, 3L ) )
+	unlink( path )
+
+	for( bad_json in c( "[1,2", "[1,2] 3", "{\"a\" 1}", "[\"\\q\"]" ) ) {
+		path <- .writeGz( bad_json )
+		h <- fromJSONAsync( path )
+		checkException( asyncJSONValue( h ), silent = TRUE )
+		checkException( asyncJSONValue( h ), silent = TRUE )
+		unlink( path )
+	}
+
+	checkException( fromJSONAsync( tempfile() ), silent = TRUE )
+}
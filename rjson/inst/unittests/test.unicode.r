@@ -46,6 +46,26 @@ test.unicode <- function()
 	x <- fromJSON( json )
 	checkIdentical( x, "Anaheim \xf0\x9f\x98\x8eDucks" )
 
+	#invalid UTF-8 bytes
+	json <- "[\"caf\xe9\", \"ok\"]"
+	checkException( fromJSON( json ), silent = TRUE )
+	checkIdentical( fromJSON( json, invalid.utf8 = "replace" ), c( "caf\uFFFD", "ok" ) )
+	checkIdentical( fromJSON( json, invalid.utf8 = "skip" ), c( "caf", "ok" ) )
+	checkException( fromJSON( "\"\xed\xa0\x80\"" ), silent = TRUE ) #encoded surrogate
+
+	#escaped surrogates which are not part of a pair are invalid too
+	checkException( fromJSON( "\"\\uD800\"" ), silent = TRUE )
+	checkException( fromJSON( "\"\\uDC00x\"" ), silent = TRUE )
+	checkIdentical( fromJSON( "\"\\uD800\\u0041\"", invalid.utf8 = "replace" ), "\uFFFDA" )
+	checkIdentical( fromJSON( "\"\\uDC00x\"", invalid.utf8 = "skip" ), "x" )
+	checkIdentical( fromJSON( "\"\\uD83D\\uDE00\"" ), "\U0001F600" )
+
+	#latin1 input and output is converted to UTF-8
+	latin1 <- "caf\xe9"
+	Encoding( latin1 ) <- "latin1"
+	checkIdentical( fromJSON( paste0( "\"", latin1, "\"" ) ), "caf\u00e9" )
+	checkIdentical( toJSON( latin1 ), "\"caf\\u00e9\"" )
+
 	x <- fromJSON("{\"a\":\"ï\"}")
 	checkIdentical( x$a, "ï" )
 	x <- toJSON(x$a)
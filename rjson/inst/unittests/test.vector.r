@@ -0,0 +1,54 @@
+.setUp <- function() {}
+.tearDown <- function() {}
+
+test.vector <- function()
+{
+	x <- fromJSONVector( c( a = "[1,2]", b = " {\"k\":\"v\"} ", c = NA ) )
+	checkIdentical( x, list( a = c(1,2), b = list( k = "v" ), c = NA ) )
+
+	checkIdentical( fromJSONVector( character(0) ), list() )
+
+	#invalid documents
+	bad_json <- c( "[1]", "{\"a\":", "1 2" )
+	x <- try( fromJSONVector( bad_json ), silent = TRUE )
+	checkTrue( any( class( x ) == "try-error" ) )
+	checkTrue( grepl( "element 2", x ) )
+	checkIdentical( fromJSONVector( bad_json, invalid = "NA" ), list( 1, NA, NA ) )
+}
+
+test.vector.dataframe <- function()
+{
+	json <- c( "{\"id\":1,\"name\":\"a\"}", "{\"name\":\"b\",\"id\":2,\"tags\":[1,2]}", "{\"id\":null}", "[1]" )
+	x <- fromJSONVector( json, integer = TRUE, invalid = "NA", output = "data.frame" )
+	checkIdentical( names( x ), c( "id", "name", "tags" ) )
+	checkIdentical( nrow( x ), 4L )
+	checkIdentical( x$id, c( 1L, 2L, NA, NA ) )
+	checkIdentical( x$name, c( "a", "b", NA, NA ) )
+	checkIdentical( x$tags, list( NULL, 1:2, NULL, NULL ) )
+
+	#documents must be objects
+	x <- try( fromJSONVector( json, output = "data.frame" ), silent = TRUE )
+	checkTrue( any( class( x ) == "try-error" ) )
+
+	#an empty object is a record, but an empty array is not
+	x <- fromJSONVector( c( "{}", " []", "{\"id\":1}" ), invalid = "NA", output = "data.frame" )
+	checkIdentical( x$id, c( NA, NA, 1 ) )
+	x <- try( fromJSONVector( c( "{}", "[]" ), output = "data.frame" ), silent = TRUE )
+	checkTrue( grepl( "element 2: not a JSON object", x ) )
+
+	#with a schema, every record has the same columns
+	s <- compileJSONSchema( list( id = "integer", name = "character" ) )
+	x <- fromJSONVector( json[1:3], schema = s, output = "data.frame" )
+	checkIdentical( x, data.frame( id = c( 1L, 2L, NA ), name = c( "a", "b", NA ), stringsAsFactors = FALSE ) )
+
+	#classed scalars keep their class, unless a column mixes classes
+	s <- compileJSONSchema( list( id = "integer", ts = "POSIXct" ) )
+	json <- c( "{\"id\":1,\"ts\":\"2020-01-02T03:04:05Z\"}", "{\"id\":2}", "{\"id\":3,\"ts\":0}" )
+	x <- fromJSONVector( json, schema = s, output = "data.frame" )
+	checkTrue( inherits( x$ts, "POSIXct" ) )
+	checkEquals( x$ts, as.POSIXct( c( "2020-01-02 03:04:05", NA, "1970-01-01 00:00:00" ), tz = "UTC" ) )
+
+	x <- fromJSONVector( c( "{\"n\":9007199254740993}", "{\"n\":\"a\"}" ), bigint = "integer64", output = "data.frame" )
+	checkTrue( is.list( x$n ) )
+	checkTrue( inherits( x$n[[1]], "integer64" ) )
+}
@@ -0,0 +1,61 @@
+.setUp <- function() {}
+.tearDown <- function() {}
+
+test.writer <- function()
+{
+	w <- newJSONWriter()
+	beginObject( w )
+	writeKey( w, "rows" )
+	beginArray( w )
+	for( i in 1:3 )
+		writeValue( w, list( id = i, name = letters[ i ] ) )
+	endArray( w )
+	writeKey( w, "n" )
+	writeValue( w, 3L )
+	endObject( w )
+	x <- closeJSONWriter( w )
+	checkIdentical( x, toJSON( list( rows = lapply( 1:3, function( i ) list( id = i, name = letters[ i ] ) ), n = 3L ) ) )
+	checkException( writeValue( w, 1 ), silent = TRUE ) #closed
+
+	#misplaced keys, values and brackets
+	w <- newJSONWriter()
+	beginObject( w )
+	checkException( writeValue( w, 1 ), silent = TRUE )
+	checkException( endArray( w ), silent = TRUE )
+	writeKey( w, "a" )
+	checkException( endObject( w ), silent = TRUE )
+	checkException( closeJSONWriter( w ), silent = TRUE )
+
+	w <- newJSONWriter()
+	writeValue( w, "x" )
+	checkException( writeValue( w, "y" ), silent = TRUE )
+	checkIdentical( closeJSONWriter( w, type = "raw" ), charToRaw( "\"x\"" ) )
+
+	#a value which can not be converted leaves the writer as it was
+	w <- newJSONWriter()
+	beginObject( w )
+	writeKey( w, "a" )
+	checkException( writeValue( w, quote( x ) ), silent = TRUE )
+	writeValue( w, 1 )
+	writeKey( w, "b" )
+	beginArray( w )
+	checkException( writeValue( w, quote( x ) ), silent = TRUE )
+	writeValue( w, 2 )
+	endArray( w )
+	endObject( w )
+	checkIdentical( closeJSONWriter( w ), "{\"a\":1,\"b\":[2]}" )
+}
+
+test.writer.connection <- function()
+{
+	con <- rawConnection( raw( 0 ), "wb" )
+	w <- newJSONWriter( con )
+	beginArray( w )
+	for( i in 1:20000 )
+		writeValue( w, list( i = i ) )
+	endArray( w )
+	closeJSONWriter( w )
+	x <- rawToChar( rawConnectionValue( con ) )
+	close( con )
+	checkIdentical( fromJSON( x, integer = TRUE ), lapply( 1:20000, function( i ) list( i = i ) ) )
+}
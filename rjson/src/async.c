@@ -0,0 +1,326 @@
+#include <R.h>
+#include <Rdefines.h>
+#include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <sys/time.h>
+#endif
+
+#include "funcs.h"
+#include "parser.h"
+
+/* Background parsing of files. fromJSONAsync opens the file, and a worker thread then reads,
+   decompresses and validates all of it, recording the structure of the document in a tape (see
+   buildJSONTape); none of this touches R, so it overlaps with whatever the R session does next.
+   Building the R objects must happen on the main thread, so that is left for asyncValue, which
+   walks the tape rather than scanning the text again: only the scalars are read from the text.
+   On Windows the work is done by fromJSONAsync itself. */
+
+#define ASYNC_TAG "rjson_async"
+/* longest wait between checks for a user interrupt */
+#define ASYNC_POLL_INTERVAL_MS 100
+
+typedef struct AsyncParse
+{
+	JSONReader* reader;
+	ParseOptions parse_options; /* arena is set while the value is built */
+
+	/* results of the worker, which are only read once done is set */
+	int status; /* JSON_OK, or the code of err */
+	JSONError err;
+	size_t end; /* offset after the value */
+	JSONTape tape;
+	char* scratch; /* string unescaping buffer for validation */
+	size_t scratch_size;
+
+#ifndef _WIN32
+	pthread_t thread;
+	int started;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+#endif
+	/* guarded by lock */
+	int done;
+	int cancelled; /* set when the handle is released before the worker finishes */
+} AsyncParse;
+
+char* reserveAsyncScratch( void* ctx, size_t size )
+{
+	AsyncParse* job = (AsyncParse*)ctx;
+	if( size > job->scratch_size ) {
+		size_t new_size = 2 * job->scratch_size > size ? 2 * job->scratch_size : size;
+		char* scratch = (char*)realloc( job->scratch, new_size );
+		if( scratch == NULL )
+			return NULL;
+		job->scratch = scratch;
+		job->scratch_size = new_size;
+	}
+	return job->scratch;
+}
+
+int isAsyncCancelled( AsyncParse* job )
+{
+#ifdef _WIN32
+	return job->cancelled;
+#else
+	pthread_mutex_lock( &job->lock );
+	int cancelled = job->cancelled;
+	pthread_mutex_unlock( &job->lock );
+	return cancelled;
+#endif
+}
+
+/* polled while the tape is built, so that releasing the handle stops the worker early */
+int isAsyncTapeCancelled( void* ctx )
+{
+	return isAsyncCancelled( (AsyncParse*)ctx );
+}
+
+/* reads, validates and builds the tape of the whole file; runs on the worker thread, so must not
+   use the R API */
+void runAsyncParse( AsyncParse* job )
+{
+	JSONReader* reader = job->reader;
+	const char* next_ch;
+	size_t n;
+
+	job->status = JSON_OK;
+	do {
+		if( isAsyncCancelled( job ) )
+			return;
+		if( readJSONReaderFile( reader, &n, &job->err ) != JSON_OK ) {
+			job->status = job->err.code;
+			return;
+		}
+	} while( !reader->eof );
+
+	/* validation doesn't warn about unexpected escapes; building the value does */
+	JSONStringOptions string_options = { job->parse_options.unexpected_escape_behavior,
+										 job->parse_options.invalid_utf8_behavior,
+										 reserveAsyncScratch,
+										 NULL,
+										 job,
+										 isAsyncTapeCancelled };
+	job->status = buildJSONTape( reader->buf, &next_ch, &job->tape, &string_options, &job->err );
+	if( job->status == JSON_OK )
+		job->end = next_ch - reader->buf;
+	free( job->scratch );
+	job->scratch = NULL;
+}
+
+#ifndef _WIN32
+void* asyncWorker( void* arg )
+{
+	AsyncParse* job = (AsyncParse*)arg;
+	runAsyncParse( job );
+	pthread_mutex_lock( &job->lock );
+	job->done = TRUE;
+	pthread_cond_signal( &job->cond );
+	pthread_mutex_unlock( &job->lock );
+	return NULL;
+}
+
+int isAsyncDone( AsyncParse* job )
+{
+	pthread_mutex_lock( &job->lock );
+	int done = job->done;
+	pthread_mutex_unlock( &job->lock );
+	return done;
+}
+
+/* waits for the worker, checking for a user interrupt every ASYNC_POLL_INTERVAL_MS */
+void waitAsyncParse( AsyncParse* job )
+{
+	pthread_mutex_lock( &job->lock );
+	while( !job->done ) {
+		struct timeval now;
+		struct timespec until;
+		gettimeofday( &now, NULL );
+		long usec = now.tv_usec + ASYNC_POLL_INTERVAL_MS * 1000L;
+		until.tv_sec = now.tv_sec + usec / 1000000;
+		until.tv_nsec = ( usec % 1000000 ) * 1000;
+		pthread_cond_timedwait( &job->cond, &job->lock, &until );
+		if( !job->done ) {
+			/* an interrupt longjmps out, so the lock must not be held */
+			pthread_mutex_unlock( &job->lock );
+			R_CheckUserInterrupt();
+			pthread_mutex_lock( &job->lock );
+		}
+	}
+	pthread_mutex_unlock( &job->lock );
+}
+#endif
+
+void freeAsyncParse( AsyncParse* job )
+{
+#ifndef _WIN32
+	if( job->started ) {
+		pthread_mutex_lock( &job->lock );
+		job->cancelled = TRUE;
+		pthread_mutex_unlock( &job->lock );
+		pthread_join( job->thread, NULL );
+		pthread_mutex_destroy( &job->lock );
+		pthread_cond_destroy( &job->cond );
+	}
+#endif
+	if( job->reader )
+		freeJSONReader( job->reader );
+	freeJSONTape( &job->tape );
+	free( job->scratch );
+	free( job );
+}
+
+void asyncFinalizer( SEXP ptr )
+{
+	AsyncParse* job = (AsyncParse*)R_ExternalPtrAddr( ptr );
+	if( job == NULL )
+		return;
+	freeAsyncParse( job );
+	R_ClearExternalPtr( ptr );
+}
+
+/* Starts parsing a (possibly compressed) file in the background; returns a handle for
+   asyncValue. Errors opening the file are raised straight away. */
+SEXP fromJSONAsync( SEXP path, SEXP options )
+{
+	SEXP ptr;
+	AsyncParse* job = (AsyncParse*)calloc( 1, sizeof( AsyncParse ) );
+	if( job == NULL )
+		Rf_error( "unable to allocate JSON parse\n" );
+	PROTECT( ptr = R_MakeExternalPtr( job, install( ASYNC_TAG ), R_NilValue ) );
+	R_RegisterCFinalizerEx( ptr, asyncFinalizer, TRUE );
+
+	readParseOptions( options, &job->parse_options );
+	job->reader = allocJSONReader();
+	openJSONReaderFile( job->reader, translateChar( STRING_ELT( path, 0 ) ) );
+
+#ifdef _WIN32
+	runAsyncParse( job );
+	job->done = TRUE;
+#else
+	pthread_mutex_init( &job->lock, NULL );
+	pthread_cond_init( &job->cond, NULL );
+	int rc = pthread_create( &job->thread, NULL, asyncWorker, job );
+	if( rc != 0 ) {
+		pthread_mutex_destroy( &job->lock );
+		pthread_cond_destroy( &job->cond );
+		Rf_error( "unable to start parsing thread: %s\n", strerror( rc ) );
+	}
+	job->started = TRUE;
+#endif
+
+	UNPROTECT( 1 );
+	return ptr;
+}
+
+AsyncParse* getAsyncParse( SEXP ptr )
+{
+	if( TYPEOF( ptr ) != EXTPTRSXP || R_ExternalPtrTag( ptr ) != install( ASYNC_TAG ) )
+		Rf_error( "handle must be created by fromJSONAsync\n" );
+	return (AsyncParse*)R_ExternalPtrAddr( ptr );
+}
+
+/* Builds an array or object from its tape node, as parseArray and parseList do. Children which
+   are arrays or objects are built from their own nodes, and the rest are parsed from the text. */
+SEXP buildAsyncContainer( AsyncParse* job, ptrdiff_t node )
+{
+	const ParseOptions* parse_options = &job->parse_options;
+	ParseArena* arena = parse_options->arena;
+	ParseArenaMark mark = markParseArena( arena );
+	const JSONTapeNode* nodes = job->tape.nodes;
+	const char* text = job->reader->buf;
+	int is_object = text[nodes[node].offset] == '{';
+	ptrdiff_t length = nodes[node].length;
+	ptrdiff_t container = node + 1;
+	const void* vmax = vmaxget();
+	const char* next_ch;
+	SEXP key, p;
+
+	if( length == 0 )
+		return allocVector( VECSXP, 0 );
+	size_t* children = (size_t*)R_alloc( length, sizeof( size_t ) );
+	getJSONTapeChildren( text, &job->tape, node, children );
+	for( ptrdiff_t i = 0; i < length; i++ ) {
+		const char* s = text + children[i];
+		if( is_object ) {
+			key = parseStringChar( s, &next_ch, parse_options );
+			if( TYPEOF( key ) != CHARSXP )
+				return key;
+			pushStringElement( arena, key );
+			s = skipJSONKey( s );
+		}
+		if( *s == '[' || *s == '{' ) {
+			p = buildAsyncContainer( job, container );
+			if( hasClass( p, TRYERROR_CLASS ) == TRUE )
+				return p;
+			pushSEXPElement( arena, p );
+			container = nodes[container].next;
+		}
+		else if( ( p = parseElement( s, &next_ch, parse_options ) ) != NULL )
+			return p;
+	}
+	vmaxset( vmax );
+	if( is_object )
+		return popList( parse_options, mark );
+	return popArray( parse_options, mark, parse_options->simplify_lists );
+}
+
+/* builds the value of a validated document from its tape */
+SEXP materializeAsyncParse( AsyncParse* job )
+{
+	const char* s = job->reader->buf;
+	const char* next_ch;
+	ParseArena arena;
+	SEXP p;
+
+	if( job->status != JSON_OK )
+		return mkCoreError( &job->err );
+	next_ch = s + job->end;
+	while( *next_ch == ' ' || *next_ch == '\t' || *next_ch == '\n' || *next_ch == '\r' )
+		next_ch++;
+	if( *next_ch != '\0' )
+		return mkError( "not all data was parsed\n" );
+
+	initParseArena( &arena );
+	job->parse_options.arena = &arena;
+	s += job->tape.nodes[0].offset;
+	if( *s == '[' || *s == '{' )
+		p = buildAsyncContainer( job, 0 );
+	else
+		p = parseValue( s, &next_ch, &job->parse_options );
+	job->parse_options.arena = NULL;
+	UNPROTECT( PARSE_ARENA_PROTECT_COUNT );
+	return p;
+}
+
+/* Waits for the worker, then builds the R value (or try-error) on the first call. The result
+   is kept by the handle, and the file's buffer released. */
+SEXP asyncValue( SEXP ptr )
+{
+	SEXP p;
+	AsyncParse* job = getAsyncParse( ptr );
+	if( job == NULL )
+		return R_ExternalPtrProtected( ptr );
+
+#ifndef _WIN32
+	waitAsyncParse( job );
+#endif
+	PROTECT( p = materializeAsyncParse( job ) );
+	R_SetExternalPtrProtected( ptr, p );
+	asyncFinalizer( ptr );
+	UNPROTECT( 1 );
+	return p;
+}
+
+/* TRUE once asyncValue would not wait */
+SEXP asyncResolved( SEXP ptr )
+{
+	AsyncParse* job = getAsyncParse( ptr );
+	if( job == NULL )
+		return ScalarLogical( TRUE );
+#ifdef _WIN32
+	return ScalarLogical( TRUE );
+#else
+	return ScalarLogical( isAsyncDone( job ) );
+#endif
+}
@@ -2,6 +2,8 @@
 #include <sstream>
 #include <iomanip>
 #include <limits>
+#include <cstring>
+#include <vector>
 
 //must include these after STL files due to length macro in Rinternals being seen by a STL on OSX.
 #include <R.h>
@@ -10,96 +12,165 @@
 
 extern "C" {
 	#include "funcs.h"
+	#include "jsoncore.h"
 }
 
 std::string escapeString( const char *s )
 {
-	std::ostringstream oss;
-	oss << '"';
+	std::string buf( JSON_ESCAPED_SIZE( strlen( s ) ), '\0' );
+	ptrdiff_t len = escapeJSONString( s, &buf[0] );
+	if( len < 0 )
+		Rf_error("unable to escape string. String is not utf8\n");
+	buf.resize( len );
+	return buf;
+}
 
-	while( *s ) {
-		switch( *s ) {
-			case '"':
-				oss << "\\\"";
-				break;
-			case '\\':
-				oss << "\\\\";
-				break;
-			case '\n':
-				oss << "\\n";
-				break;
-			case '\r':
-				oss << "\\r";
-				break;
-			case '\t':
-				oss << "\\t";
-				break;
-			default:
-				unsigned char ch = static_cast<unsigned char>(*s);
-				if (( ch <= 0x1F ) || (ch == 0x7F)) {
-					unsigned short val = ch;
-					oss << "\\u" << std::setfill('0') << std::setw(4) << std::hex << val << std::dec;
-				} else if( ch < 0x80 ) {
-					// 0xxxxxxx
-					oss << *s;
-				} else if( (ch & 0xE0) == 0xC0 && s[1] ) {
-					// 110xxxxx 10xxxxxx
-					unsigned short val = (s[1] & 0x3F) + ((s[0] & 0x1F) << 6);
-					oss << "\\u" << std::setfill('0') << std::setw(4) << std::hex << val << std::dec;
-					s += 1;
-				} else if( (ch & 0xF0) == 0xE0 && s[1] && s[2] ) {
-					// 1110xxxx 10xxxxxx 10xxxxxx
-					unsigned short val = (s[2] & 0x3F) + ((s[1] & 0x3F) << 6) + ((s[0] & 0x0F) << 12);
-					oss << "\\u" << std::setfill('0') << std::setw(4) << std::hex << val << std::dec;
-					s += 2;
-				} else if( (ch & 0xF8) == 0xF0 && s[1] && s[2] && s[3] ) {
-					// 11110xxx 10xxxxxx 10xxxxxx 10xxxxxx
-					unsigned long val = (s[3] & 0x3F) + ((s[2] & 0x3F) << 6) + ((s[1] & 0x3F) << 12) + ((s[0] & 0x07) << 18);
-					// Per JSON spec, encode as UTF-16 https://en.wikipedia.org/wiki/UTF-16#Code_points_from_U+010000_to_U+10FFFF
-					// Could probably do directly from UTF-8 for improved performance
-					unsigned long U = val - 0x10000;
-					unsigned short hi = (U >> 10) + 0xD800;
-					unsigned short lo = (U & 0x3FF) + 0xDC00;
-					oss << "\\u" << std::setfill('0') << std::setw(4) << std::hex << hi << std::dec;
-					oss << "\\u" << std::setfill('0') << std::setw(4) << std::hex << lo << std::dec;
-					s += 3;
-				} else {
-					Rf_error("unable to escape string. String is not utf8\n");
-				}
-		}
-		s++;
-	}
+// Escapes a CHARSXP, transcoding it to UTF-8 first when its encoding is declared as latin1 (or
+// is native in a non UTF-8 locale). translateCharUTF8 returns ASCII and UTF-8 strings as they are.
+std::string escapeChar( SEXP ch )
+{
+	cetype_t encoding = Rf_getCharCE( ch );
+	if( encoding == CE_UTF8 || encoding == CE_BYTES )
+		return escapeString( CHAR(ch) );
+	const void* vmax = vmaxget();
+	std::string s = escapeString( Rf_translateCharUTF8( ch ) );
+	vmaxset( vmax );
+	return s;
+}
 
-	oss << '"';
-	return oss.str();
+// Raw vectors are written as a single base64 string, encoded straight into the output; as the
+// base64 alphabet needs no escaping, the string is never scanned again.
+std::string rawToJSON( SEXP x )
+{
+	std::string buf( JSON_BASE64_SIZE( XLENGTH(x) ) + 2, '"' );
+	encodeBase64( RAW(x), XLENGTH(x), &buf[1] );
+	return buf;
 }
 
 #define NO_CONTAINER 0
 #define ARRAY_CONTAINER 1
 #define OBJECT_CONTAINER 2
 
-std::string toJSON2( SEXP x, int indent, int indent_amount )
+// The container x is written in: an object when it has names, and an array unless it is a single
+// unnamed atomic value. toMsgPack2 makes the same choice as toJSON2, so both read back alike.
+int getContainer( SEXP x, SEXP names )
+{
+	if( names != R_NilValue ) {
+		if( Rf_length(names) != Rf_length(x) )
+			Rf_error("number of names does not match number of elements\n");
+		return OBJECT_CONTAINER;
+	}
+	if( Rf_length(x) != 1 || TYPEOF(x) == VECSXP )
+		return ARRAY_CONTAINER;
+	return NO_CONTAINER;
+}
+
+struct DumpOptions
+{
+	int indent_amount;
+	bool matrix_rowmajor; // write matrices and arrays as nested arrays, rather than flattened vectors
+};
+
+// writes a single element of an atomic vector without levels
+void scalarToJSON( std::ostringstream& oss, SEXP x, R_xlen_t i )
+{
+	switch( TYPEOF(x) ) {
+		case LGLSXP:
+			if( LOGICAL(x)[i] == NA_LOGICAL )
+				oss << "\"NA\"";
+			else
+				oss << ( LOGICAL(x)[i] ? "true" : "false" );
+			break;
+		case INTSXP:
+			if( INTEGER(x)[i] == NA_INTEGER )
+				oss << "\"NA\"";
+			else
+				oss << INTEGER(x)[i];
+			break;
+		case REALSXP:
+			if( ISNA(REAL(x)[i]) ) {
+				oss << "\"NA\"";
+			} else if( ISNAN(REAL(x)[i]) ) {
+				oss << "\"NaN\"";
+			} else if( R_FINITE(REAL(x)[i]) ) {
+				oss << std::setprecision( std::numeric_limits<double>::digits10 ) << REAL(x)[i];
+			} else {
+				oss << (REAL(x)[i] > 0 ? "\"Inf\"" : "\"-Inf\"");
+			}
+			break;
+		case STRSXP:
+			if( STRING_ELT(x,i) == NA_STRING )
+				oss << "\"NA\"";
+			else
+				oss << escapeChar(STRING_ELT(x,i));
+			break;
+	}
+}
+
+// Writes dimension `level` of an array as nested JSON arrays, the first dimension outermost.
+// Elements are read straight from R's column-major storage: element [i1,i2,...] is at
+// offset i1 + d1*i2 + d1*d2*i3 ..., so each level walks its index with the product of the
+// preceding dimensions as its stride.
+void matrixToJSON( std::ostringstream& oss, SEXP x, const int* dims, int ndims, int level, R_xlen_t offset, int indent, const DumpOptions& options )
+{
+	R_xlen_t stride = 1;
+	for( int i = 0; i < level; i++ )
+		stride *= dims[i];
+
+	oss << "[";
+	indent += options.indent_amount;
+	if( options.indent_amount > 0 ) { oss << "\n"; }
+	for( int i = 0; i < dims[level]; i++ ) {
+		if( i > 0 ) {
+			oss << ",";
+			if( options.indent_amount > 0 ) { oss << "\n"; }
+		}
+		oss << std::setw(indent) << "";
+		if( level == ndims - 1 )
+			scalarToJSON( oss, x, offset + i * stride );
+		else
+			matrixToJSON( oss, x, dims, ndims, level + 1, offset + i * stride, indent, options );
+	}
+	indent -= options.indent_amount;
+	if( options.indent_amount > 0 ) { oss << "\n"; }
+	oss << std::setw(indent) << "";
+	oss << "]";
+}
+
+std::string toJSON2( SEXP x, int indent, const DumpOptions& options )
 {
 	if( x == R_NilValue )
 		return "null";
 
+	if( TYPEOF(x) == RAWSXP )
+		return rawToJSON( x );
+
+	int indent_amount = options.indent_amount;
+	if( options.matrix_rowmajor ) {
+		SEXP dim = Rf_getAttrib( x, R_DimSymbol );
+		if( Rf_length( dim ) >= 2 && GET_LEVELS( x ) == R_NilValue && !Rf_inherits( x, "integer64" ) &&
+			( TYPEOF(x) == LGLSXP || TYPEOF(x) == INTSXP || TYPEOF(x) == REALSXP || TYPEOF(x) == STRSXP ) ) {
+			std::ostringstream oss;
+			matrixToJSON( oss, x, INTEGER( dim ), Rf_length( dim ), 0, 0, indent, options );
+			return oss.str();
+		}
+	}
+
 	int i = 0;
 	int n = Rf_length(x);
 	SEXP names;
 	PROTECT( names = GET_NAMES(x) );
 
-	//int container = NO_CONTAINER;
+	int container = getContainer( x, names );
 	std::string container_closer;
 	std::ostringstream oss;
 	
-	if( names != NULL_USER_OBJECT ) {
+	if( container == OBJECT_CONTAINER ) {
 		oss << "{";
 		container_closer = "}";
 		if( indent_amount > 0 ) { oss << "\n"; }
 		indent += indent_amount;
-		if( Rf_length(names) != n )
-			Rf_error("number of names does not match number of elements\n");
-	} else if( n != 1 || TYPEOF(x) == VECSXP ) {
+	} else if( container == ARRAY_CONTAINER ) {
 		oss << "[";
 		container_closer = "]";
 		indent += indent_amount;
@@ -118,7 +189,7 @@ std::string toJSON2( SEXP x, int indent, int indent_amount )
 				}
 				oss << std::setw(indent) << "";
 				if( names != NULL_USER_OBJECT )
-					oss << escapeString(CHAR(STRING_ELT(names, i))) << ":";
+					oss << escapeChar(STRING_ELT(names, i)) << ":";
 				if( LOGICAL(x)[i] == NA_INTEGER )
 					oss << "\"NA\"";
 				else if( ISNAN( LOGICAL(x)[i] ) )
@@ -137,18 +208,38 @@ std::string toJSON2( SEXP x, int indent, int indent_amount )
 				}
 				oss << std::setw(indent) << "";
 				if( names != NULL_USER_OBJECT )
-					oss << escapeString(CHAR(STRING_ELT(names, i))) << ":";
+					oss << escapeChar(STRING_ELT(names, i)) << ":";
 				if( INTEGER(x)[i] == NA_INTEGER )
 					oss << "\"NA\"";
 				else if( ISNAN( INTEGER(x)[i] ) )
 					oss << "\"NaN\"";
 				else if( levels != NULL_USER_OBJECT )
-					oss << escapeString(CHAR(STRING_ELT(levels, INTEGER(x)[i] - 1 )));
+					oss << escapeChar(STRING_ELT(levels, INTEGER(x)[i] - 1 ));
 				else
 					oss << INTEGER(x)[i];
 			}
 			break;
 		case REALSXP:
+			if( Rf_inherits( x, "integer64" ) ) {
+				// bit64 stores 64 bit integers in the bits of a double, with LLONG_MIN as NA
+				for( i = 0; i < n; i++ ) {
+					if( i > 0 ) {
+						oss << ",";
+						if( indent_amount > 0 ) { oss << "\n"; }
+					}
+					oss << std::setw(indent) << "";
+					if( names != NULL_USER_OBJECT ) {
+						oss << escapeChar(STRING_ELT(names, i)) << ":";
+					}
+					long long val;
+					memcpy( &val, REAL(x) + i, sizeof(val) );
+					if( val == std::numeric_limits<long long>::min() )
+						oss << "\"NA\"";
+					else
+						oss << val;
+				}
+				break;
+			}
 			for( i = 0; i < n; i++ ) {
 				if( i > 0 ) {
 					oss << ",";
@@ -156,7 +247,7 @@ std::string toJSON2( SEXP x, int indent, int indent_amount )
 				}
 				oss << std::setw(indent) << "";
 				if( names != NULL_USER_OBJECT ) {
-					oss << escapeString(CHAR(STRING_ELT(names, i))) << ":";
+					oss << escapeChar(STRING_ELT(names, i)) << ":";
 				}
 				if( ISNA(REAL(x)[i]) ) {
 					oss << "\"NA\"";
@@ -181,7 +272,7 @@ std::string toJSON2( SEXP x, int indent, int indent_amount )
 				REAL(p)[1] = COMPLEX(x)[i].i;
 
 				Rf_setAttrib( p, R_NamesSymbol, p_names );
-				oss << toJSON2(p, indent, indent_amount);
+				oss << toJSON2(p, indent, options);
 				UNPROTECT(2);
 			}
 			break;
@@ -192,11 +283,11 @@ std::string toJSON2( SEXP x, int indent, int indent_amount )
 					if( indent_amount > 0 ) { oss << "\n"; }
 				}
 				if( names != NULL_USER_OBJECT )
-					oss << escapeString(CHAR(STRING_ELT(names, i))) << ":";
+					oss << escapeChar(STRING_ELT(names, i)) << ":";
 				if( STRING_ELT(x,i) == NA_STRING )
 					oss << "\"NA\"";
 				else
-					oss << escapeString(CHAR(STRING_ELT(x,i)));
+					oss << escapeChar(STRING_ELT(x,i));
 			}
 			break;
 		case VECSXP:
@@ -207,8 +298,8 @@ std::string toJSON2( SEXP x, int indent, int indent_amount )
 				}
 				oss << std::setw(indent) << "";
 				if( names != NULL_USER_OBJECT )
-					oss << escapeString(CHAR(STRING_ELT(names, i))) << ":";
-				oss << toJSON2( VECTOR_ELT(x,i), indent, indent_amount );
+					oss << escapeChar(STRING_ELT(names, i)) << ":";
+				oss << toJSON2( VECTOR_ELT(x,i), indent, options );
 			}
 			break;
 		default:
@@ -225,11 +316,13 @@ std::string toJSON2( SEXP x, int indent, int indent_amount )
 }
 
 extern "C" {
-	SEXP toJSON( SEXP obj, SEXP indent )
+	SEXP toJSON( SEXP obj, SEXP indent, SEXP matrix_rowmajor )
 	{
-		int indent_amount = INTEGER(indent)[0];
+		DumpOptions options;
+		options.indent_amount = INTEGER(indent)[0];
+		options.matrix_rowmajor = LOGICAL(matrix_rowmajor)[0] == TRUE;
 
-		std::string buf = toJSON2( obj, 0, indent_amount );
+		std::string buf = toJSON2( obj, 0, options );
 		SEXP p;
 		PROTECT(p=Rf_allocVector(STRSXP, 1));
 		SET_STRING_ELT(p, 0, Rf_mkCharCE( buf.c_str(), CE_UTF8 ));
@@ -238,3 +331,344 @@ extern "C" {
 	}
 }
 
+
+// An incremental writer, which serializes one value, key or bracket at a time into a single
+// growing buffer, so a large document never has to exist as an R object.
+#define WRITER_TAG "rjson_writer"
+
+struct WriterContainer
+{
+	char closer; // ']' or '}'
+	R_xlen_t count; // elements (or keys) written so far
+};
+
+struct JSONWriter
+{
+	std::string buf;
+	std::vector<WriterContainer> stack;
+	bool after_key; // a key has been written, and its value is expected next
+	bool complete; // a whole top level value has been written
+	DumpOptions options;
+};
+
+void writerFinalizer( SEXP ptr )
+{
+	JSONWriter* writer = static_cast<JSONWriter*>( R_ExternalPtrAddr( ptr ) );
+	if( writer == NULL )
+		return;
+	delete writer;
+	R_ClearExternalPtr( ptr );
+}
+
+JSONWriter* getJSONWriter( SEXP ptr )
+{
+	if( TYPEOF( ptr ) != EXTPTRSXP || R_ExternalPtrTag( ptr ) != Rf_install( WRITER_TAG ) )
+		Rf_error( "writer must be created by newJSONWriter\n" );
+	if( R_ExternalPtrAddr( ptr ) == NULL )
+		Rf_error( "writer is closed\n" );
+	return static_cast<JSONWriter*>( R_ExternalPtrAddr( ptr ) );
+}
+
+// checks a value may be written here; the writer is only changed (by beginWriterValue) once the
+// value has been serialized, so a value which fails to serialize leaves it as it was
+void checkWriterValue( JSONWriter* writer )
+{
+	if( writer->stack.empty() ) {
+		if( writer->complete )
+			Rf_error( "the JSON document is already complete\n" );
+		return;
+	}
+	if( writer->stack.back().closer == '}' && !writer->after_key )
+		Rf_error( "a key must be written before each value of an object\n" );
+}
+
+// writes the separator before a value checked by checkWriterValue
+void beginWriterValue( JSONWriter* writer )
+{
+	if( writer->stack.empty() )
+		return;
+	WriterContainer& top = writer->stack.back();
+	if( top.closer == '}' )
+		writer->after_key = false;
+	else if( top.count++ > 0 )
+		writer->buf += ',';
+}
+
+void endWriterValue( JSONWriter* writer )
+{
+	if( writer->stack.empty() )
+		writer->complete = true;
+}
+
+extern "C" {
+	SEXP newJSONWriter( SEXP matrix_rowmajor )
+	{
+		JSONWriter* writer = new JSONWriter();
+		writer->after_key = false;
+		writer->complete = false;
+		writer->options.indent_amount = 0;
+		writer->options.matrix_rowmajor = LOGICAL(matrix_rowmajor)[0] == TRUE;
+
+		SEXP ptr;
+		PROTECT( ptr = R_MakeExternalPtr( writer, Rf_install( WRITER_TAG ), R_NilValue ) );
+		R_RegisterCFinalizerEx( ptr, writerFinalizer, TRUE );
+		UNPROTECT( 1 );
+		return ptr;
+	}
+
+	// opens an array, or an object when object is TRUE
+	SEXP writeJSONBegin( SEXP ptr, SEXP object )
+	{
+		JSONWriter* writer = getJSONWriter( ptr );
+		bool is_object = LOGICAL(object)[0] == TRUE;
+		checkWriterValue( writer );
+		beginWriterValue( writer );
+		WriterContainer container = { is_object ? '}' : ']', 0 };
+		writer->stack.push_back( container );
+		writer->buf += is_object ? '{' : '[';
+		return R_NilValue;
+	}
+
+	SEXP writeJSONEnd( SEXP ptr, SEXP object )
+	{
+		JSONWriter* writer = getJSONWriter( ptr );
+		char closer = LOGICAL(object)[0] == TRUE ? '}' : ']';
+		if( writer->stack.empty() || writer->stack.back().closer != closer )
+			Rf_error( "there is no open %s to end\n", closer == '}' ? "object" : "array" );
+		if( writer->after_key )
+			Rf_error( "the last key has no value\n" );
+		writer->stack.pop_back();
+		writer->buf += closer;
+		endWriterValue( writer );
+		return R_NilValue;
+	}
+
+	SEXP writeJSONKey( SEXP ptr, SEXP key )
+	{
+		JSONWriter* writer = getJSONWriter( ptr );
+		if( writer->stack.empty() || writer->stack.back().closer != '}' )
+			Rf_error( "keys can only be written inside an object\n" );
+		if( writer->after_key )
+			Rf_error( "the last key has no value\n" );
+		if( TYPEOF( key ) != STRSXP || Rf_length( key ) != 1 || STRING_ELT( key, 0 ) == NA_STRING )
+			Rf_error( "key must be a single string\n" );
+		std::string escaped = escapeChar( STRING_ELT( key, 0 ) );
+		if( writer->stack.back().count++ > 0 )
+			writer->buf += ',';
+		writer->buf += escaped;
+		writer->buf += ':';
+		writer->after_key = true;
+		return R_NilValue;
+	}
+
+	// writes a whole R value, exactly as toJSON would
+	SEXP writeJSONValue( SEXP ptr, SEXP x )
+	{
+		JSONWriter* writer = getJSONWriter( ptr );
+		checkWriterValue( writer );
+		std::string value = toJSON2( x, 0, writer->options );
+		beginWriterValue( writer );
+		writer->buf += value;
+		endWriterValue( writer );
+		return R_NilValue;
+	}
+
+	// Returns the buffered output as a raw vector and empties the buffer, once at least min_size
+	// bytes are buffered; otherwise returns NULL. This is how output is streamed to a connection.
+	SEXP flushJSONWriter( SEXP ptr, SEXP min_size )
+	{
+		JSONWriter* writer = getJSONWriter( ptr );
+		if( writer->buf.empty() || writer->buf.size() < (size_t)Rf_asReal( min_size ) )
+			return R_NilValue;
+		SEXP p;
+		PROTECT( p = Rf_allocVector( RAWSXP, writer->buf.size() ) );
+		memcpy( RAW(p), writer->buf.data(), writer->buf.size() );
+		writer->buf.clear();
+		UNPROTECT( 1 );
+		return p;
+	}
+
+	// Checks the document is complete, and returns whatever is still buffered, as a string or a
+	// raw vector. The writer's memory is released straight away.
+	SEXP closeJSONWriter( SEXP ptr, SEXP raw )
+	{
+		JSONWriter* writer = getJSONWriter( ptr );
+		if( !writer->stack.empty() )
+			Rf_error( "unable to close writer: the %s is not ended\n",
+					  writer->stack.back().closer == '}' ? "object" : "array" );
+		if( !writer->complete )
+			Rf_error( "unable to close writer: nothing was written\n" );
+
+		SEXP p;
+		if( LOGICAL(raw)[0] == TRUE ) {
+			PROTECT( p = Rf_allocVector( RAWSXP, writer->buf.size() ) );
+			memcpy( RAW(p), writer->buf.data(), writer->buf.size() );
+		} else {
+			PROTECT( p = Rf_allocVector( STRSXP, 1 ) );
+			SET_STRING_ELT( p, 0, Rf_mkCharLenCE( writer->buf.data(), writer->buf.size(), CE_UTF8 ) );
+		}
+		writerFinalizer( ptr );
+		UNPROTECT( 1 );
+		return p;
+	}
+}
+
+
+// MessagePack output, which follows toJSON2: the same values become maps, arrays and scalars,
+// and missing and non-finite values are written as the same strings, so fromMsgPack( toMsgPack( x ) )
+// is fromJSON( toJSON( x ) ). Numbers are written exactly in binary rather than as text, integers
+// as MessagePack integers, and raw vectors as MessagePack binaries.
+void appendMsgPackHeader( std::string& buf, int type, size_t length )
+{
+	unsigned char header[MSGPACK_MAX_HEADER];
+	size_t n = writeMsgPackHeader( type, length, header );
+	if( n == 0 )
+		Rf_error("unable to convert a value of length %.0f to MessagePack\n", (double)length);
+	buf.append( (const char*)header, n );
+}
+
+void appendMsgPackInteger( std::string& buf, long long value )
+{
+	unsigned char out[MSGPACK_MAX_HEADER];
+	buf.append( (const char*)out, writeMsgPackInteger( value, out ) );
+}
+
+void appendMsgPackString( std::string& buf, const char* s )
+{
+	size_t n = strlen( s );
+	appendMsgPackHeader( buf, MSGPACK_STRING, n );
+	buf.append( s, n );
+}
+
+// as escapeChar, transcodes strings which are not UTF-8 first
+void appendMsgPackChar( std::string& buf, SEXP ch )
+{
+	cetype_t encoding = Rf_getCharCE( ch );
+	if( encoding == CE_UTF8 || encoding == CE_BYTES ) {
+		appendMsgPackString( buf, CHAR(ch) );
+		return;
+	}
+	const void* vmax = vmaxget();
+	appendMsgPackString( buf, Rf_translateCharUTF8( ch ) );
+	vmaxset( vmax );
+}
+
+void appendMsgPackReal( std::string& buf, double value )
+{
+	unsigned char out[MSGPACK_MAX_HEADER];
+	if( ISNA(value) )
+		appendMsgPackString( buf, "NA" );
+	else if( ISNAN(value) )
+		appendMsgPackString( buf, "NaN" );
+	else if( !R_FINITE(value) )
+		appendMsgPackString( buf, value > 0 ? "Inf" : "-Inf" );
+	else
+		buf.append( (const char*)out, writeMsgPackDouble( value, out ) );
+}
+
+void toMsgPack2( std::string& buf, SEXP x );
+
+// writes element i of a vector; levels are those of a factor, and is_integer64 is set for bit64
+// vectors
+void elementToMsgPack( std::string& buf, SEXP x, SEXP levels, bool is_integer64, R_xlen_t i )
+{
+	switch( TYPEOF(x) ) {
+		case LGLSXP:
+			if( LOGICAL(x)[i] == NA_LOGICAL )
+				appendMsgPackString( buf, "NA" );
+			else
+				appendMsgPackHeader( buf, MSGPACK_BOOLEAN, LOGICAL(x)[i] != 0 );
+			break;
+		case INTSXP:
+			if( INTEGER(x)[i] == NA_INTEGER )
+				appendMsgPackString( buf, "NA" );
+			else if( levels != R_NilValue )
+				appendMsgPackChar( buf, STRING_ELT( levels, INTEGER(x)[i] - 1 ) );
+			else
+				appendMsgPackInteger( buf, INTEGER(x)[i] );
+			break;
+		case REALSXP:
+			if( is_integer64 ) {
+				long long val;
+				memcpy( &val, REAL(x) + i, sizeof(val) );
+				if( val == std::numeric_limits<long long>::min() )
+					appendMsgPackString( buf, "NA" );
+				else
+					appendMsgPackInteger( buf, val );
+			} else {
+				appendMsgPackReal( buf, REAL(x)[i] );
+			}
+			break;
+		case CPLXSXP:
+			appendMsgPackHeader( buf, MSGPACK_MAP, 2 );
+			appendMsgPackString( buf, "real" );
+			appendMsgPackReal( buf, COMPLEX(x)[i].r );
+			appendMsgPackString( buf, "imaginary" );
+			appendMsgPackReal( buf, COMPLEX(x)[i].i );
+			break;
+		case STRSXP:
+			if( STRING_ELT(x, i) == NA_STRING )
+				appendMsgPackString( buf, "NA" );
+			else
+				appendMsgPackChar( buf, STRING_ELT(x, i) );
+			break;
+		case VECSXP:
+			toMsgPack2( buf, VECTOR_ELT(x, i) );
+			break;
+	}
+}
+
+void toMsgPack2( std::string& buf, SEXP x )
+{
+	if( x == R_NilValue ) {
+		appendMsgPackHeader( buf, MSGPACK_NIL, 0 );
+		return;
+	}
+
+	switch( TYPEOF(x) ) {
+		case RAWSXP:
+			appendMsgPackHeader( buf, MSGPACK_BINARY, XLENGTH(x) );
+			buf.append( (const char*)RAW(x), XLENGTH(x) );
+			return;
+		case LGLSXP:
+		case INTSXP:
+		case REALSXP:
+		case CPLXSXP:
+		case STRSXP:
+		case VECSXP:
+			break;
+		default:
+			Rf_error("unable to convert R type %i to MessagePack\n", TYPEOF(x));
+	}
+
+	SEXP names, levels;
+	PROTECT( names = GET_NAMES(x) );
+	PROTECT( levels = GET_LEVELS(x) );
+	R_xlen_t n = XLENGTH(x);
+	int container = getContainer( x, names );
+	if( container == OBJECT_CONTAINER )
+		appendMsgPackHeader( buf, MSGPACK_MAP, n );
+	else if( container == ARRAY_CONTAINER )
+		appendMsgPackHeader( buf, MSGPACK_ARRAY, n );
+
+	bool is_integer64 = TYPEOF(x) == REALSXP && Rf_inherits( x, "integer64" );
+	for( R_xlen_t i = 0; i < n; i++ ) {
+		if( container == OBJECT_CONTAINER )
+			appendMsgPackChar( buf, STRING_ELT(names, i) );
+		elementToMsgPack( buf, x, levels, is_integer64, i );
+	}
+	UNPROTECT( 2 );
+}
+
+extern "C" {
+	SEXP toMsgPack( SEXP obj )
+	{
+		std::string buf;
+		toMsgPack2( buf, obj );
+		SEXP p;
+		PROTECT( p = Rf_allocVector( RAWSXP, buf.size() ) );
+		memcpy( RAW(p), buf.data(), buf.size() );
+		UNPROTECT( 1 );
+		return p;
+	}
+}
@@ -1,2 +1,28 @@
-SEXP fromJSON( SEXP str_in, SEXP unexpected_escape_behavior, SEXP simplify );
-SEXP toJSON( SEXP obj, SEXP indent );
+SEXP fromJSON( SEXP str_in, SEXP options, SEXP schema );
+SEXP fromJSONVector( SEXP str_in, SEXP options, SEXP schema, SEXP invalid_na, SEXP data_frame );
+SEXP fromJSONFile( SEXP path, SEXP options, SEXP schema );
+SEXP fromNDJSON( SEXP path, SEXP options, SEXP schema, SEXP invalid_na, SEXP data_frame );
+SEXP toJSON( SEXP obj, SEXP indent, SEXP matrix_rowmajor );
+SEXP compileJSONSchema( SEXP schema_list );
+SEXP newJSONWriter( SEXP matrix_rowmajor );
+SEXP writeJSONBegin( SEXP ptr, SEXP object );
+SEXP writeJSONEnd( SEXP ptr, SEXP object );
+SEXP writeJSONKey( SEXP ptr, SEXP key );
+SEXP writeJSONValue( SEXP ptr, SEXP x );
+SEXP flushJSONWriter( SEXP ptr, SEXP min_size );
+SEXP closeJSONWriter( SEXP ptr, SEXP raw );
+SEXP newJSONReader( SEXP input, SEXP command );
+SEXP appendJSONReader( SEXP ptr, SEXP data );
+SEXP readJSONFrames( SEXP ptr, SEXP options, SEXP timeout );
+SEXP parseJSONLazy( SEXP str_in, SEXP options );
+SEXP lazyGet( SEXP handle, SEXP i );
+SEXP lazyLength( SEXP handle );
+SEXP lazyNames( SEXP handle );
+SEXP lazyValue( SEXP handle );
+SEXP lazyType( SEXP handle );
+SEXP fromJSONAsync( SEXP path, SEXP options );
+SEXP asyncValue( SEXP ptr );
+SEXP asyncResolved( SEXP ptr );
+SEXP toMsgPack( SEXP obj );
+SEXP fromMsgPack( SEXP x, SEXP options );
+SEXP hashedGet( SEXP x, SEXP key );
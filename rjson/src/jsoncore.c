@@ -0,0 +1,1229 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jsoncore.h"
+
+#define MAX_NUMBER_BUF 256
+
+#define MASKBITS 0x3F
+#define MASKBYTE 0x80
+#define MASK2BYTES 0xC0
+#define MASK3BYTES 0xE0
+#define MASK4BYTES 0xF0
+
+int setJSONError( JSONError* err, int code, const char* format, ... )
+{
+	va_list args;
+	va_start( args, format );
+	vsnprintf( err->message, sizeof( err->message ), format, args );
+	va_end( args );
+	err->code = code;
+	return code;
+}
+
+int UTF8EncodeUnicode( unsigned long input, char* s )
+{
+	/* 0xxxxxxx */
+	if( input < 0x80 ) {
+		s[0] = input;
+		return 1;
+	}
+	/* 110xxxxx 10xxxxxx */
+	else if( input < 0x800 ) {
+		s[0] = ( MASK2BYTES | ( input >> 6 ) );
+		s[1] = ( MASKBYTE | ( input & MASKBITS ) );
+		return 2;
+	}
+	/* 1110xxxx 10xxxxxx 10xxxxxx */
+	else if( input < 0x10000 ) {
+		s[0] = ( MASK3BYTES | ( input >> 12 ) );
+		s[1] = ( MASKBYTE | ( ( input >> 6 ) & MASKBITS ) );
+		s[2] = ( MASKBYTE | ( input & MASKBITS ) );
+		return 3;
+	}
+	/* 11110xxx 10xxxxxx 10xxxxxx 10xxxxxx */
+	else {
+		s[0] = ( MASK4BYTES | ( input >> 18 ) );
+		s[1] = ( MASKBYTE | ( ( input >> 12 ) & MASKBITS ) );
+		s[2] = ( MASKBYTE | ( ( input >> 6 ) & MASKBITS ) );
+		s[3] = ( MASKBYTE | ( input & MASKBITS ) );
+		return 4;
+	}
+}
+
+int readSequence( const char* s, int i, unsigned short* unicode )
+{
+	for( int j = 1; j <= 4; j++ )
+		if( ( ( s[i + j] >= 'a' && s[i + j] <= 'f' ) || ( s[i + j] >= 'A' && s[i + j] <= 'F' ) ||
+			  ( s[i + j] >= '0' && s[i + j] <= '9' ) ) == 0 ) {
+			return j - 1;
+		}
+	char unicode_buf[5]; /* to hold 4 digit hex (to prevent scanning a 5th digit accidentally */
+	strncpy( unicode_buf, s + i + 1, 5 );
+	unicode_buf[4] = '\0';
+	sscanf( unicode_buf, "%hx", unicode );
+	return 4;
+}
+
+/* Attempts to parse a javascript escaped UTF-16 sequence into a unicode codepoint from a buffer.
+   If the sequence is invalid no unicode value will be set.
+   The function will return the number of read bytes as an indicator of whether input was successfully parsed */
+int parseUTF16Sequence( const char* s, int i, unsigned long* unicode )
+{
+	int read_bytes = 0;
+	unsigned short high;
+	read_bytes += readSequence( s, i, &high );
+	if( read_bytes != 4 )
+		return read_bytes;
+	/* check if this is a UTF-16 surrogate pair */
+	if( ( high >= 0xD800 && high <= 0xDBFF ) &&
+		( s[i + read_bytes + 1] == '\\' && s[i + read_bytes + 2] == 'u' ) ) {
+		read_bytes += 2;
+		i += read_bytes; /* parse the next UTF-16 sequence, we are now pointing at the next 'u' */
+		unsigned short low;
+		read_bytes += readSequence( s, i, &low );
+		if( read_bytes != 10 )
+			return read_bytes;
+		/* not a pair: the high surrogate is returned alone, and the next escape read by itself */
+		if( low < 0xDC00 || low > 0xDFFF ) {
+			*unicode = high;
+			return 4;
+		}
+		*unicode = ( (unsigned long)( high - 0xD800 ) ) * 0x400 + ( low - 0xDC00 ) +
+				   0x10000; /* Decode the surrogate pair into a unicode codepoint */
+	}
+	else
+		*unicode = high;
+
+	return read_bytes;
+}
+
+/* Returns the number of leading ASCII bytes of s. Eight bytes are checked at a time, as any
+   non-ASCII byte sets a high bit in its word. */
+size_t asciiPrefixLength( const unsigned char* s, size_t n )
+{
+	size_t i = 0;
+	uint64_t word;
+	for( ; i + 8 <= n; i += 8 ) {
+		memcpy( &word, s + i, 8 );
+		if( word & UINT64_C( 0x8080808080808080 ) )
+			break;
+	}
+	while( i < n && s[i] < 0x80 )
+		i++;
+	return i;
+}
+
+/* Returns the length of the well formed UTF-8 sequence at the start of s (of n bytes), or 0.
+   Overlong encodings, surrogates and code points beyond U+10FFFF are rejected. */
+int utf8SequenceLength( const unsigned char* s, size_t n )
+{
+	if( s[0] < 0x80 )
+		return 1;
+	if( s[0] < 0xC2 )
+		return 0;
+	if( s[0] < 0xE0 )
+		return n >= 2 && ( s[1] & 0xC0 ) == 0x80 ? 2 : 0;
+	if( s[0] < 0xF0 ) {
+		if( n < 3 || ( s[1] & 0xC0 ) != 0x80 || ( s[2] & 0xC0 ) != 0x80 )
+			return 0;
+		if( ( s[0] == 0xE0 && s[1] < 0xA0 ) || ( s[0] == 0xED && s[1] >= 0xA0 ) )
+			return 0;
+		return 3;
+	}
+	if( s[0] < 0xF5 ) {
+		if( n < 4 || ( s[1] & 0xC0 ) != 0x80 || ( s[2] & 0xC0 ) != 0x80 || ( s[3] & 0xC0 ) != 0x80 )
+			return 0;
+		if( ( s[0] == 0xF0 && s[1] < 0x90 ) || ( s[0] == 0xF4 && s[1] >= 0x90 ) )
+			return 0;
+		return 4;
+	}
+	return 0;
+}
+
+int scanJSONNull( const char* s, const char** next_ch, JSONError* err )
+{
+	if( strncmp( s, "null", 4 ) == 0 ) {
+		*next_ch = s + 4;
+		return JSON_OK;
+	}
+
+	/* TODO should really look at subset of "null" (e.g. "nul", "nu" ), so that "not" fails before reaching 4 digits */
+	if( strlen( s ) < 4 ) {
+		return setJSONError( err,
+							 JSON_INCOMPLETE,
+							 "parseNull: expected to see 'null' - likely an unquoted string "
+							 "starting with 'n', or truncated null.\n" );
+	}
+	return setJSONError(
+		err,
+		JSON_ERROR,
+		"parseNull: expected to see 'null' - likely an unquoted string starting with 'n'.\n" );
+}
+
+int scanJSONTrue( const char* s, const char** next_ch, JSONError* err )
+{
+	if( strncmp( s, "true", 4 ) == 0 ) {
+		*next_ch = s + 4;
+		return JSON_OK;
+	}
+	if( strlen( s ) < 4 ) {
+		return setJSONError( err,
+							 JSON_INCOMPLETE,
+							 "parseTrue: expected to see 'true' - likely an unquoted string "
+							 "starting with 't', or truncated true.\n" );
+	}
+	return setJSONError(
+		err,
+		JSON_ERROR,
+		"parseTrue: expected to see 'true' - likely an unquoted string starting with 't'.\n" );
+}
+
+int scanJSONFalse( const char* s, const char** next_ch, JSONError* err )
+{
+	if( strncmp( s, "false", 5 ) == 0 ) {
+		*next_ch = s + 5;
+		return JSON_OK;
+	}
+	if( strlen( s ) < 5 ) {
+		return setJSONError( err,
+							 JSON_INCOMPLETE,
+							 "parseFalse: expected to see 'false' - likely an unquoted string "
+							 "starting with 'f', or truncated false.\n" );
+	}
+	return setJSONError(
+		err,
+		JSON_ERROR,
+		"parseFalse: expected to see 'false' - likely an unquoted string starting with 'f'.\n" );
+}
+
+/* Validates the syntax of a number, and sets next_ch to the character following it */
+int skipJSONNumber( const char* s, const char** next_ch, JSONError* err )
+{
+	int digits_before_period = 0;
+	int exponent_digits = 0;
+
+	if( *s == '-' ) {
+		s++;
+	}
+
+	if( *s == '\0' ) {
+		return setJSONError( err, JSON_INCOMPLETE, "parseNumer error\n" );
+	}
+
+	if( *s == '0' ) {
+		digits_before_period++;
+		s++;
+		if( ( *s >= '0' && *s <= '9' ) || *s == 'x' ) {
+			return setJSONError( err, JSON_ERROR, "hex or octal is not valid json\n" );
+		}
+	}
+
+	while( *s >= '0' && *s <= '9' ) {
+		digits_before_period++;
+		s++;
+	}
+
+	if( *s == '.' ) {
+		if( digits_before_period == 0 ) {
+			return setJSONError( err, JSON_ERROR, "numbers must start with a digit\n" );
+		}
+		s++;
+		while( *s >= '0' && *s <= '9' ) {
+			s++;
+		}
+	}
+
+	/* exponential */
+	if( *s == 'e' || *s == 'E' ) {
+		s++;
+		if( *s == '+' || *s == '-' ) {
+			s++;
+		}
+		while( *s >= '0' && *s <= '9' ) {
+			s++;
+			exponent_digits++;
+		}
+		if( exponent_digits == 0 ) {
+			return setJSONError( err, JSON_ERROR, "missing exponent\n" );
+		}
+	}
+
+	*next_ch = s;
+	return JSON_OK;
+}
+
+/* Reads a number as a double */
+int scanJSONNumber( const char* s, const char** next_ch, double* value, JSONError* err )
+{
+	char buf[MAX_NUMBER_BUF];
+	if( skipJSONNumber( s, next_ch, err ) != JSON_OK )
+		return err->code;
+
+	unsigned int len = *next_ch - s;
+	if( len >= MAX_NUMBER_BUF ) {
+		return setJSONError( err,
+							 JSON_ERROR,
+							 "buffer issue parsing number: increase MAX_NUMBER_BUF (in jsoncore.c) "
+							 "current value is %i\n",
+							 MAX_NUMBER_BUF );
+	}
+
+	/* copy to buf, which is used with atof */
+	strncpy( buf, s, len );
+	buf[len] = '\0';
+
+	*value = atof( buf );
+	return JSON_OK;
+}
+
+/* Returns 1 and sets value when the (already scanned) number from s to end is integral and fits
+   in 64 bits, -1 for larger integers, or 0 for fractions and exponents. */
+int scanJSONInteger( const char* s, const char* end, long long* value )
+{
+	const char* p;
+	for( p = *s == '-' ? s + 1 : s; p < end; p++ )
+		if( *p < '0' || *p > '9' )
+			return 0; /* fraction or exponent */
+
+	char* number_end;
+	errno = 0;
+	*value = strtoll( s, &number_end, 10 );
+	return errno == 0 && number_end == end ? 1 : -1;
+}
+
+/* Appends n bytes of string data to the reserved buffer at *buf_i, checking they are UTF-8.
+   Invalid bytes are an error, or are replaced by U+FFFD or dropped, as options asks. */
+int copyUTF8( const char* src, size_t n, int* buf_i, const JSONStringOptions* options, JSONError* err )
+{
+	const unsigned char* s = (const unsigned char*)src;
+	size_t i = 0;
+	int len;
+	char* buf;
+
+	if( ( buf = options->reserve( options->ctx, *buf_i + n + 1 ) ) == NULL )
+		return setJSONError( err, JSON_ERROR, "out of memory unescaping string\n" );
+	while( 1 ) {
+		/* copy the longest valid run in one go */
+		size_t start = i;
+		while( i < n ) {
+			i += asciiPrefixLength( s + i, n - i );
+			if( i == n || ( len = utf8SequenceLength( s + i, n - i ) ) == 0 )
+				break;
+			i += len;
+		}
+		memcpy( buf + *buf_i, src + start, i - start );
+		*buf_i += i - start;
+		if( i == n )
+			return JSON_OK;
+
+		switch( options->invalid_utf8_behavior ) {
+		case INVALID_UTF8_REPLACE:
+			if( ( buf = options->reserve( options->ctx, *buf_i + 3 + ( n - i ) + 1 ) ) == NULL )
+				return setJSONError( err, JSON_ERROR, "out of memory unescaping string\n" );
+			memcpy( buf + *buf_i, "\xEF\xBF\xBD", 3 );
+			*buf_i += 3;
+			break;
+		case INVALID_UTF8_SKIP:
+			break;
+		default:
+			return setJSONError( err, JSON_ERROR, "invalid UTF-8 byte 0x%02X in string\n", s[i] );
+		}
+		i++;
+	}
+}
+
+int unescapeJSONString( const char* s,
+						const char** next_ch,
+						const JSONStringOptions* options,
+						size_t* len,
+						JSONError* err )
+{
+	char message[128];
+	/* assert( s[ 0 ] == '"' ); */
+	int i = 1; /* skip the start quote */
+
+	char* buf;
+	int buf_i = 0;
+
+	int copy_start = i;
+	int bytes_to_copy;
+
+	while( 1 ) {
+		while( s[i] != '\\' && s[i] != '"' && s[i] != '\0' )
+			i++;
+		if( s[i] == '\0' ) {
+			return setJSONError( err, JSON_INCOMPLETE, "unclosed string\n" );
+		}
+
+		bytes_to_copy = i - copy_start;
+
+		if( s[i] == '\\' ) {
+			if( s[i + 1] == '\0' ) {
+				return setJSONError( err, JSON_INCOMPLETE, "unclosed string\n" );
+			}
+			/* TODO couldn't this be caught above (where s[ i ] == '\0') */
+			if( s[i + 2] == '\0' ) {
+				return setJSONError( err, JSON_INCOMPLETE, "unclosed string\n" );
+			}
+
+			/* save string chunk from copy_start to i-1 */
+			if( bytes_to_copy > 0 &&
+				copyUTF8( s + copy_start, bytes_to_copy, &buf_i, options, err ) != JSON_OK )
+				return err->code;
+			/* room for up to 4 bytes of an escape sequence and the '\0' */
+			if( ( buf = options->reserve( options->ctx, buf_i + 5 ) ) == NULL )
+				return setJSONError( err, JSON_ERROR, "out of memory unescaping string\n" );
+			i++;
+
+			/* save s[i] */
+			switch( s[i] ) {
+			case '"':
+			case '\\':
+			case '/':
+				buf[buf_i] = s[i];
+				break;
+			case 'b':
+				buf[buf_i] = '\b';
+				break;
+			case 'f':
+				buf[buf_i] = '\f';
+				break;
+			case 'n':
+				buf[buf_i] = '\n';
+				break;
+			case 'r':
+				buf[buf_i] = '\r';
+				break;
+			case 't':
+				buf[buf_i] = '\t';
+				break;
+			case 'u': ; /* semi-colon required to prevent windows-compile warning related to var declaration inside case statement */
+				unsigned long unicode;
+				int read_bytes = parseUTF16Sequence( s, i, &unicode );
+				if( read_bytes != 4 && read_bytes != 10 ) {
+					/* In case of surrogate pairs read_bytes will be 10 */
+					return setJSONError( err,
+										 JSON_ERROR,
+										 "unexpected unicode escaped char '%c'; 4 hex digits should "
+										 "follow the \\u (found %i valid digits)",
+										 s[i + read_bytes + 1],
+										 read_bytes );
+				}
+				i +=
+					read_bytes; /* skip the UTF16 sequence(s) - actually point to last digit, which is then incremented outside of switch */
+				if( unicode >= 0xD800 && unicode <= 0xDFFF ) {
+					/* a lone surrogate has no UTF-8 encoding, so it is handled as an invalid byte is */
+					if( options->invalid_utf8_behavior == INVALID_UTF8_REPLACE )
+						unicode = 0xFFFD;
+					else if( options->invalid_utf8_behavior == INVALID_UTF8_SKIP ) {
+						buf_i--;
+						break;
+					}
+					else
+						return setJSONError(
+							err, JSON_ERROR, "invalid unicode escape \\u%04lX (a lone surrogate)\n", unicode );
+				}
+				buf_i += UTF8EncodeUnicode( unicode, buf + buf_i ) -
+						 1; /* -1 due to buf_i++ out of loop */
+				break;
+			default:
+				if( options->unexpected_escape_behavior == UNEXPECTED_ESCAPE_SKIP ) {
+					/* skip the character (by decreasing the buffer index as it will be increased below. in actuality we dont want it to change). */
+					buf_i--;
+					if( options->warn ) {
+						snprintf( message, sizeof( message ),
+								  "unexpected escaped character '\\%c' at pos %i. Skipping value.", s[i], i );
+						options->warn( options->ctx, message );
+					}
+				}
+				else if( options->unexpected_escape_behavior == UNEXPECTED_ESCAPE_KEEP ) {
+					/* treat a "\y" as simply 'y' */
+					buf[buf_i] = s[i];
+					if( options->warn ) {
+						snprintf( message, sizeof( message ),
+								  "unexpected escaped character '\\%c' at pos %i. Keeping value.", s[i], i );
+						options->warn( options->ctx, message );
+					}
+					if( (unsigned char)s[i] >= 0x80 ) {
+						/* a multibyte character is copied (and validated) with the chunk after it */
+						buf_i--;
+						i--;
+					}
+				}
+				else {
+					/* case of UNEXPECTED_ESCAPE_ERROR, or any other bad enum values */
+					return setJSONError(
+						err, JSON_ERROR, "unexpected escaped character '\\%c' at pos %i", s[i], i );
+				}
+				break;
+			}
+
+			i++; /* move to next char */
+			copy_start = i;
+			buf_i++;
+		}
+		else {
+			/* must be a quote that caused us the exit the loop, save remaining string data */
+			if( bytes_to_copy > 0 &&
+				copyUTF8( s + copy_start, bytes_to_copy, &buf_i, options, err ) != JSON_OK )
+				return err->code;
+			if( ( buf = options->reserve( options->ctx, buf_i + 1 ) ) == NULL )
+				return setJSONError( err, JSON_ERROR, "out of memory unescaping string\n" );
+			buf[buf_i] = '\0';
+			break; /* exit the loop */
+		}
+	}
+
+	*next_ch = s + i + 1;
+	*len = buf_i;
+	return JSON_OK;
+}
+
+int skipJSONValue( const char* s, const char** next_ch, JSONError* err )
+{
+	int first = 1;
+
+	/* ignore whitespace */
+	while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+		s++;
+
+	switch( *s ) {
+	case '\0':
+		return setJSONError( err, JSON_INCOMPLETE, "no data to parse\n" );
+	case 't':
+		return scanJSONTrue( s, next_ch, err );
+	case 'f':
+		return scanJSONFalse( s, next_ch, err );
+	case 'n':
+		return scanJSONNull( s, next_ch, err );
+	case '"':
+		for( s++; *s != '"'; s++ ) {
+			if( *s == '\0' || ( *s == '\\' && *++s == '\0' ) )
+				return setJSONError( err, JSON_INCOMPLETE, "unclosed string\n" );
+		}
+		*next_ch = s + 1;
+		return JSON_OK;
+	case '[':
+	case '{': {
+		char closer = *s == '[' ? ']' : '}';
+		s++;
+		while( 1 ) {
+			while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+				s++;
+			if( *s == '\0' )
+				return setJSONError(
+					err, JSON_INCOMPLETE, "incomplete %s\n", closer == ']' ? "array" : "list" );
+			if( *s == closer && first )
+				break;
+			first = 0;
+
+			if( closer == '}' ) {
+				if( *s != '"' )
+					return setJSONError( err,
+										 JSON_ERROR,
+										 "unexpected character \"%c\"; expecting opening string quote "
+										 "(\") for key value\n",
+										 *s );
+				if( skipJSONValue( s, next_ch, err ) != JSON_OK )
+					return err->code;
+				s = *next_ch;
+				while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+					s++;
+				if( *s != ':' ) {
+					if( *s == '\0' )
+						return setJSONError( err, JSON_INCOMPLETE, "incomplete list - missing :\n" );
+					return setJSONError( err, JSON_ERROR, "incomplete list - missing :\n" );
+				}
+				s++;
+			}
+
+			if( skipJSONValue( s, next_ch, err ) != JSON_OK )
+				return err->code;
+			s = *next_ch;
+			while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+				s++;
+			if( *s == closer )
+				break;
+			if( *s == '\0' )
+				return setJSONError(
+					err, JSON_INCOMPLETE, "incomplete %s\n", closer == ']' ? "array" : "list" );
+			if( *s != ',' )
+				return setJSONError( err, JSON_ERROR, "unexpected character: %c\n", *s );
+			s++;
+		}
+		*next_ch = s + 1;
+		return JSON_OK;
+	}
+	}
+	if( ( *s >= '0' && *s <= '9' ) || *s == '-' )
+		return skipJSONNumber( s, next_ch, err );
+	return setJSONError( err, JSON_ERROR, "unexpected character '%c'\n", *s );
+}
+
+ptrdiff_t pushJSONTapeNode( JSONTape* tape, size_t offset )
+{
+	if( tape->n_nodes == tape->size ) {
+		ptrdiff_t new_size = tape->size > 0 ? 2 * tape->size : 256;
+		JSONTapeNode* nodes = (JSONTapeNode*)realloc( tape->nodes, new_size * sizeof( JSONTapeNode ) );
+		if( nodes == NULL )
+			return -1;
+		tape->nodes = nodes;
+		tape->size = new_size;
+	}
+	JSONTapeNode* node = &tape->nodes[tape->n_nodes];
+	node->offset = offset;
+	node->end = offset;
+	node->next = tape->n_nodes + 1;
+	node->length = 0;
+	return tape->n_nodes++;
+}
+
+/* number of values between polls of JSONStringOptions.cancelled */
+#define JSON_TAPE_POLL_INTERVAL 65536
+
+int tapeValue( const char* text,
+			   const char* s,
+			   const char** next_ch,
+			   JSONTape* tape,
+			   const JSONStringOptions* options,
+			   JSONError* err )
+{
+	ptrdiff_t index = -1;
+	size_t len;
+	int rc;
+
+	while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+		s++;
+
+	/* the top level value always has a node, so a document with a scalar one can be found too */
+	if( *s == '[' || *s == '{' || tape->n_values == 0 ) {
+		index = pushJSONTapeNode( tape, s - text );
+		if( index < 0 )
+			return setJSONError( err, JSON_ERROR, "out of memory building JSON tape\n" );
+	}
+	tape->n_values++;
+	if( options->cancelled && tape->n_values % JSON_TAPE_POLL_INTERVAL == 0 && options->cancelled( options->ctx ) )
+		return setJSONError( err, JSON_ERROR, "building the JSON tape was cancelled\n" );
+
+	switch( *s ) {
+	case '\0':
+		return setJSONError( err, JSON_INCOMPLETE, "no data to parse\n" );
+	case 't':
+		rc = scanJSONTrue( s, next_ch, err );
+		break;
+	case 'f':
+		rc = scanJSONFalse( s, next_ch, err );
+		break;
+	case 'n':
+		rc = scanJSONNull( s, next_ch, err );
+		break;
+	case '"':
+		rc = unescapeJSONString( s, next_ch, options, &len, err );
+		break;
+	case '[':
+	case '{': {
+		char closer = *s == '[' ? ']' : '}';
+		ptrdiff_t length = 0;
+		s++;
+		while( 1 ) {
+			while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+				s++;
+			if( *s == '\0' )
+				return setJSONError(
+					err, JSON_INCOMPLETE, "incomplete %s\n", closer == ']' ? "array" : "list" );
+			if( *s == closer && length == 0 )
+				break;
+
+			if( closer == '}' ) {
+				if( *s != '"' )
+					return setJSONError( err,
+										 JSON_ERROR,
+										 "unexpected character \"%c\"; expecting opening string quote "
+										 "(\") for key value\n",
+										 *s );
+				if( unescapeJSONString( s, next_ch, options, &len, err ) != JSON_OK )
+					return err->code;
+				s = *next_ch;
+				while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+					s++;
+				if( *s != ':' ) {
+					if( *s == '\0' )
+						return setJSONError( err, JSON_INCOMPLETE, "incomplete list - missing :\n" );
+					return setJSONError( err, JSON_ERROR, "incomplete list - missing :\n" );
+				}
+				s++;
+			}
+
+			if( tapeValue( text, s, next_ch, tape, options, err ) != JSON_OK )
+				return err->code;
+			length++;
+			s = *next_ch;
+			while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+				s++;
+			if( *s == closer )
+				break;
+			if( *s == '\0' )
+				return setJSONError(
+					err, JSON_INCOMPLETE, "incomplete %s\n", closer == ']' ? "array" : "list" );
+			if( *s != ',' )
+				return setJSONError( err, JSON_ERROR, "unexpected character: %c\n", *s );
+			s++;
+		}
+		*next_ch = s + 1;
+		/* the tape may have moved while adding the children */
+		tape->nodes[index].next = tape->n_nodes;
+		tape->nodes[index].length = length;
+		tape->nodes[index].end = *next_ch - text;
+		return JSON_OK;
+	}
+	default:
+		if( ( *s >= '0' && *s <= '9' ) || *s == '-' )
+			rc = skipJSONNumber( s, next_ch, err );
+		else
+			return setJSONError( err, JSON_ERROR, "unexpected character '%c'\n", *s );
+	}
+	if( rc == JSON_OK && index >= 0 )
+		tape->nodes[index].end = *next_ch - text;
+	return rc;
+}
+
+int buildJSONTape( const char* text,
+				   const char** next_ch,
+				   JSONTape* tape,
+				   const JSONStringOptions* options,
+				   JSONError* err )
+{
+	tape->n_values = 0;
+	return tapeValue( text, text, next_ch, tape, options, err );
+}
+
+void freeJSONTape( JSONTape* tape )
+{
+	free( tape->nodes );
+	tape->nodes = NULL;
+	tape->n_nodes = tape->size = tape->n_values = 0;
+}
+
+/* skips a string which has already been validated */
+const char* skipValidJSONString( const char* s )
+{
+	for( s++; *s != '"'; s++ )
+		if( *s == '\\' )
+			s++;
+	return s + 1;
+}
+
+const char* skipJSONKey( const char* key )
+{
+	const char* s = skipValidJSONString( key );
+	while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' || *s == ':' )
+		s++;
+	return s;
+}
+
+void getJSONTapeChildren( const char* text, const JSONTape* tape, ptrdiff_t node, size_t* offsets )
+{
+	const JSONTapeNode* nodes = tape->nodes;
+	int is_object = text[nodes[node].offset] == '{';
+	const char* s = text + nodes[node].offset + 1;
+	ptrdiff_t container = node + 1;
+
+	for( ptrdiff_t k = 0; k < nodes[node].length; k++ ) {
+		while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' || *s == ',' )
+			s++;
+		offsets[k] = s - text;
+		if( is_object )
+			s = skipJSONKey( s );
+		if( *s == '[' || *s == '{' ) {
+			/* nested arrays and objects are skipped with their own nodes, which follow in order */
+			s = text + nodes[container].end;
+			container = nodes[container].next;
+		}
+		else if( *s == '"' )
+			s = skipValidJSONString( s );
+		else
+			while( *s != ',' && *s != ']' && *s != '}' && *s != ' ' && *s != '\t' && *s != '\n' &&
+				   *s != '\r' )
+				s++;
+	}
+}
+
+ptrdiff_t escapeJSONString( const char* s, char* out )
+{
+	static const char hex[] = "0123456789abcdef";
+	char* o = out;
+	*o++ = '"';
+
+	while( *s ) {
+		unsigned char ch = (unsigned char)*s;
+		unsigned long val;
+		switch( ch ) {
+		case '"':
+			*o++ = '\\';
+			*o++ = '"';
+			break;
+		case '\\':
+			*o++ = '\\';
+			*o++ = '\\';
+			break;
+		case '\n':
+			*o++ = '\\';
+			*o++ = 'n';
+			break;
+		case '\r':
+			*o++ = '\\';
+			*o++ = 'r';
+			break;
+		case '\t':
+			*o++ = '\\';
+			*o++ = 't';
+			break;
+		default:
+			if( ch < 0x80 && ch > 0x1F && ch != 0x7F ) {
+				/* 0xxxxxxx */
+				*o++ = *s;
+				break;
+			}
+			if( ch < 0x80 ) {
+				val = ch;
+			}
+			else if( ( ch & 0xE0 ) == 0xC0 && s[1] ) {
+				/* 110xxxxx 10xxxxxx */
+				val = ( s[1] & 0x3F ) + ( ( s[0] & 0x1F ) << 6 );
+				s += 1;
+			}
+			else if( ( ch & 0xF0 ) == 0xE0 && s[1] && s[2] ) {
+				/* 1110xxxx 10xxxxxx 10xxxxxx */
+				val = ( s[2] & 0x3F ) + ( ( s[1] & 0x3F ) << 6 ) + ( ( s[0] & 0x0F ) << 12 );
+				s += 2;
+			}
+			else if( ( ch & 0xF8 ) == 0xF0 && s[1] && s[2] && s[3] ) {
+				/* 11110xxx 10xxxxxx 10xxxxxx 10xxxxxx; written as a UTF-16 surrogate pair, as the
+				   JSON spec requires */
+				unsigned long U = ( s[3] & 0x3F ) + ( ( s[2] & 0x3F ) << 6 ) +
+								  ( ( s[1] & 0x3F ) << 12 ) + ( ( s[0] & 0x07 ) << 18 ) - 0x10000;
+				unsigned long hi = ( U >> 10 ) + 0xD800;
+				*o++ = '\\';
+				*o++ = 'u';
+				*o++ = hex[( hi >> 12 ) & 0xF];
+				*o++ = hex[( hi >> 8 ) & 0xF];
+				*o++ = hex[( hi >> 4 ) & 0xF];
+				*o++ = hex[hi & 0xF];
+				val = ( U & 0x3FF ) + 0xDC00;
+				s += 3;
+			}
+			else {
+				return -1;
+			}
+			*o++ = '\\';
+			*o++ = 'u';
+			*o++ = hex[( val >> 12 ) & 0xF];
+			*o++ = hex[( val >> 8 ) & 0xF];
+			*o++ = hex[( val >> 4 ) & 0xF];
+			*o++ = hex[val & 0xF];
+		}
+		s++;
+	}
+
+	*o++ = '"';
+	return o - out;
+}
+
+static const char base64_alphabet[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* every pair of base64 characters, indexed by the 12 bits they encode, so that three bytes are
+   encoded with two lookups */
+#define BASE64_ROW( c ) \
+	c "A" c "B" c "C" c "D" c "E" c "F" c "G" c "H" c "I" c "J" c "K" c "L" c "M" c "N" c "O" c "P" \
+	c "Q" c "R" c "S" c "T" c "U" c "V" c "W" c "X" c "Y" c "Z" c "a" c "b" c "c" c "d" c "e" c "f" \
+	c "g" c "h" c "i" c "j" c "k" c "l" c "m" c "n" c "o" c "p" c "q" c "r" c "s" c "t" c "u" c "v" \
+	c "w" c "x" c "y" c "z" c "0" c "1" c "2" c "3" c "4" c "5" c "6" c "7" c "8" c "9" c "+" c "/"
+static const char base64_pairs[] =
+	BASE64_ROW( "A" ) BASE64_ROW( "B" ) BASE64_ROW( "C" ) BASE64_ROW( "D" ) BASE64_ROW( "E" )
+	BASE64_ROW( "F" ) BASE64_ROW( "G" ) BASE64_ROW( "H" ) BASE64_ROW( "I" ) BASE64_ROW( "J" )
+	BASE64_ROW( "K" ) BASE64_ROW( "L" ) BASE64_ROW( "M" ) BASE64_ROW( "N" ) BASE64_ROW( "O" )
+	BASE64_ROW( "P" ) BASE64_ROW( "Q" ) BASE64_ROW( "R" ) BASE64_ROW( "S" ) BASE64_ROW( "T" )
+	BASE64_ROW( "U" ) BASE64_ROW( "V" ) BASE64_ROW( "W" ) BASE64_ROW( "X" ) BASE64_ROW( "Y" )
+	BASE64_ROW( "Z" ) BASE64_ROW( "a" ) BASE64_ROW( "b" ) BASE64_ROW( "c" ) BASE64_ROW( "d" )
+	BASE64_ROW( "e" ) BASE64_ROW( "f" ) BASE64_ROW( "g" ) BASE64_ROW( "h" ) BASE64_ROW( "i" )
+	BASE64_ROW( "j" ) BASE64_ROW( "k" ) BASE64_ROW( "l" ) BASE64_ROW( "m" ) BASE64_ROW( "n" )
+	BASE64_ROW( "o" ) BASE64_ROW( "p" ) BASE64_ROW( "q" ) BASE64_ROW( "r" ) BASE64_ROW( "s" )
+	BASE64_ROW( "t" ) BASE64_ROW( "u" ) BASE64_ROW( "v" ) BASE64_ROW( "w" ) BASE64_ROW( "x" )
+	BASE64_ROW( "y" ) BASE64_ROW( "z" ) BASE64_ROW( "0" ) BASE64_ROW( "1" ) BASE64_ROW( "2" )
+	BASE64_ROW( "3" ) BASE64_ROW( "4" ) BASE64_ROW( "5" ) BASE64_ROW( "6" ) BASE64_ROW( "7" )
+	BASE64_ROW( "8" ) BASE64_ROW( "9" ) BASE64_ROW( "+" ) BASE64_ROW( "/" );
+
+size_t encodeBase64( const unsigned char* s, size_t n, char* out )
+{
+	char* o = out;
+	size_t i = 0;
+	/* three bytes become four characters */
+	for( ; i + 3 <= n; i += 3 ) {
+		uint32_t group = ( (uint32_t)s[i] << 16 ) | ( (uint32_t)s[i + 1] << 8 ) | s[i + 2];
+		memcpy( o, base64_pairs + 2 * ( group >> 12 ), 2 );
+		memcpy( o + 2, base64_pairs + 2 * ( group & 0xFFF ), 2 );
+		o += 4;
+	}
+	if( i < n ) {
+		unsigned long group = (unsigned long)s[i] << 16;
+		if( i + 1 < n )
+			group |= s[i + 1] << 8;
+		o[0] = base64_alphabet[group >> 18];
+		o[1] = base64_alphabet[( group >> 12 ) & 0x3F];
+		o[2] = i + 1 < n ? base64_alphabet[( group >> 6 ) & 0x3F] : '=';
+		o[3] = '=';
+		o += 4;
+	}
+	return o - out;
+}
+
+/* the value of each base64 character, or -1 */
+#define BASE64_VALUES( F ) \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( 62 ), F( -1 ), F( -1 ), F( -1 ), F( 63 ), F( 52 ), F( 53 ), \
+	F( 54 ), F( 55 ), F( 56 ), F( 57 ), F( 58 ), F( 59 ), F( 60 ), F( 61 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( 0 ), F( 1 ), F( 2 ), F( 3 ), F( 4 ), \
+	F( 5 ), F( 6 ), F( 7 ), F( 8 ), F( 9 ), F( 10 ), F( 11 ), F( 12 ), F( 13 ), F( 14 ), \
+	F( 15 ), F( 16 ), F( 17 ), F( 18 ), F( 19 ), F( 20 ), F( 21 ), F( 22 ), F( 23 ), F( 24 ), \
+	F( 25 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( 26 ), F( 27 ), F( 28 ), \
+	F( 29 ), F( 30 ), F( 31 ), F( 32 ), F( 33 ), F( 34 ), F( 35 ), F( 36 ), F( 37 ), F( 38 ), \
+	F( 39 ), F( 40 ), F( 41 ), F( 42 ), F( 43 ), F( 44 ), F( 45 ), F( 46 ), F( 47 ), F( 48 ), \
+	F( 49 ), F( 50 ), F( 51 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), \
+	F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 ), F( -1 )
+#define BASE64_VALUE( v ) v
+static const signed char base64_values[256] = { BASE64_VALUES( BASE64_VALUE ) };
+
+/* The values again, already shifted into place in a group of four characters; invalid
+   characters set a bit above the 24 bits of the group, so a group is checked with one test. */
+#define BASE64_INVALID 0x1000000UL
+#define BASE64_SHIFT18( v ) ( ( v ) < 0 ? BASE64_INVALID : (uint32_t)( v ) << 18 )
+#define BASE64_SHIFT12( v ) ( ( v ) < 0 ? BASE64_INVALID : (uint32_t)( v ) << 12 )
+#define BASE64_SHIFT6( v ) ( ( v ) < 0 ? BASE64_INVALID : (uint32_t)( v ) << 6 )
+#define BASE64_SHIFT0( v ) ( ( v ) < 0 ? BASE64_INVALID : (uint32_t)( v ) )
+static const uint32_t base64_values18[256] = { BASE64_VALUES( BASE64_SHIFT18 ) };
+static const uint32_t base64_values12[256] = { BASE64_VALUES( BASE64_SHIFT12 ) };
+static const uint32_t base64_values6[256] = { BASE64_VALUES( BASE64_SHIFT6 ) };
+static const uint32_t base64_values0[256] = { BASE64_VALUES( BASE64_SHIFT0 ) };
+
+/* the length of s without up to two trailing '=', which pad the last group */
+size_t unpaddedBase64Length( const char* s, size_t n )
+{
+	if( n > 0 && s[n - 1] == '=' )
+		n--;
+	if( n > 0 && s[n - 1] == '=' )
+		n--;
+	return n;
+}
+
+size_t base64DecodedSize( const char* s, size_t n )
+{
+	n = unpaddedBase64Length( s, n );
+	return n / 4 * 3 + ( n % 4 ? n % 4 - 1 : 0 );
+}
+
+ptrdiff_t decodeBase64( const char* s, size_t n, unsigned char* out )
+{
+	const unsigned char* in = (const unsigned char*)s;
+	unsigned char* o = out;
+	size_t i = 0;
+
+	n = unpaddedBase64Length( s, n );
+	if( n % 4 == 1 )
+		return -1;
+
+	/* four characters become three bytes */
+	for( ; i + 4 <= n; i += 4 ) {
+		uint32_t group = base64_values18[in[i]] | base64_values12[in[i + 1]] | base64_values6[in[i + 2]] |
+						 base64_values0[in[i + 3]];
+		if( group >= BASE64_INVALID )
+			return -1;
+		o[0] = group >> 16;
+		o[1] = ( group >> 8 ) & 0xFF;
+		o[2] = group & 0xFF;
+		o += 3;
+	}
+	/* a final group of two or three characters */
+	if( i < n ) {
+		long group = 0;
+		for( size_t j = i; j < n; j++ ) {
+			if( base64_values[in[j]] < 0 )
+				return -1;
+			group = ( group << 6 ) | base64_values[in[j]];
+		}
+		if( n - i == 2 ) {
+			o[0] = group >> 4;
+			o += 1;
+		}
+		else {
+			o[0] = group >> 10;
+			o[1] = ( group >> 2 ) & 0xFF;
+			o += 2;
+		}
+	}
+	return o - out;
+}
+
+int copyJSONString( const char* s, size_t n, const JSONStringOptions* options, size_t* len, JSONError* err )
+{
+	int buf_i = 0;
+	char* buf;
+	/* leaves room for every byte to be replaced by U+FFFD */
+	if( n > INT_MAX / 4 )
+		return setJSONError( err, JSON_ERROR, "string is too long\n" );
+	if( copyUTF8( s, n, &buf_i, options, err ) != JSON_OK )
+		return err->code;
+	if( ( buf = options->reserve( options->ctx, buf_i + 1 ) ) == NULL )
+		return setJSONError( err, JSON_ERROR, "out of memory unescaping string\n" );
+	buf[buf_i] = '\0';
+	*len = buf_i;
+	return JSON_OK;
+}
+
+uint64_t readBigEndian( const unsigned char* s, int size )
+{
+	uint64_t value = 0;
+	for( int i = 0; i < size; i++ )
+		value = ( value << 8 ) | s[i];
+	return value;
+}
+
+void writeBigEndian( uint64_t value, int size, unsigned char* out )
+{
+	for( int i = size - 1; i >= 0; i-- ) {
+		out[i] = value & 0xFF;
+		value >>= 8;
+	}
+}
+
+/* the signed value of a size byte two's complement integer */
+long long signExtend( uint64_t value, int size )
+{
+	int64_t extended;
+	if( size < 8 && ( value >> ( 8 * size - 1 ) ) )
+		value |= ~(uint64_t)0 << ( 8 * size );
+	memcpy( &extended, &value, sizeof( extended ) );
+	return extended;
+}
+
+int scanMsgPackItem( const unsigned char* s,
+					 const unsigned char* end,
+					 const unsigned char** next,
+					 MsgPackItem* item,
+					 JSONError* err )
+{
+	int c, size = 0; /* bytes of the value, or of the length, which follow the type byte */
+	uint64_t value;
+
+	if( s >= end )
+		return setJSONError( err, JSON_INCOMPLETE, "incomplete MessagePack value\n" );
+	c = *s++;
+	item->data = NULL;
+	item->length = 0;
+
+	/* types which hold their value or length in the type byte */
+	if( c <= 0x7F || c >= 0xE0 ) {
+		item->type = MSGPACK_INTEGER;
+		item->u.integer = c <= 0x7F ? c : c - 0x100;
+		*next = s;
+		return JSON_OK;
+	}
+	if( c <= 0x9F ) {
+		item->type = c <= 0x8F ? MSGPACK_MAP : MSGPACK_ARRAY;
+		item->length = c & 0x0F;
+		*next = s;
+		return JSON_OK;
+	}
+	if( c <= 0xBF ) {
+		item->type = MSGPACK_STRING;
+		item->length = c & 0x1F;
+	}
+	else {
+		switch( c ) {
+		case 0xC0:
+			item->type = MSGPACK_NIL;
+			break;
+		case 0xC2:
+		case 0xC3:
+			item->type = MSGPACK_BOOLEAN;
+			item->u.boolean = c == 0xC3;
+			break;
+		case 0xC4:
+		case 0xC5:
+		case 0xC6:
+			item->type = MSGPACK_BINARY;
+			size = 1 << ( c - 0xC4 );
+			break;
+		case 0xCA:
+		case 0xCB:
+			item->type = MSGPACK_FLOAT;
+			size = c == 0xCA ? 4 : 8;
+			break;
+		case 0xCC:
+		case 0xCD:
+		case 0xCE:
+		case 0xCF:
+		case 0xD0:
+		case 0xD1:
+		case 0xD2:
+		case 0xD3:
+			item->type = MSGPACK_INTEGER;
+			size = 1 << ( ( c - 0xCC ) % 4 );
+			break;
+		case 0xD9:
+		case 0xDA:
+		case 0xDB:
+			item->type = MSGPACK_STRING;
+			size = 1 << ( c - 0xD9 );
+			break;
+		case 0xDC:
+		case 0xDD:
+			item->type = MSGPACK_ARRAY;
+			size = 2 << ( c - 0xDC );
+			break;
+		case 0xDE:
+		case 0xDF:
+			item->type = MSGPACK_MAP;
+			size = 2 << ( c - 0xDE );
+			break;
+		case 0xC1:
+			return setJSONError( err, JSON_ERROR, "invalid MessagePack type 0xC1\n" );
+		default:
+			return setJSONError( err, JSON_ERROR, "unsupported MessagePack extension type 0x%02X\n", c );
+		}
+	}
+
+	if( end - s < size )
+		return setJSONError( err, JSON_INCOMPLETE, "incomplete MessagePack value\n" );
+	value = readBigEndian( s, size );
+	s += size;
+
+	switch( item->type ) {
+	case MSGPACK_INTEGER:
+		if( c >= 0xD0 ) {
+			item->u.integer = signExtend( value, size );
+		}
+		else if( value > LLONG_MAX ) {
+			item->type = MSGPACK_UNSIGNED;
+			item->u.unsigned_integer = value;
+		}
+		else {
+			item->u.integer = (long long)value;
+		}
+		break;
+	case MSGPACK_FLOAT:
+		if( size == 4 ) {
+			uint32_t bits = (uint32_t)value;
+			float number;
+			memcpy( &number, &bits, sizeof( number ) );
+			item->u.number = number;
+		}
+		else {
+			memcpy( &item->u.number, &value, sizeof( item->u.number ) );
+		}
+		break;
+	case MSGPACK_STRING:
+	case MSGPACK_BINARY:
+		if( size > 0 )
+			item->length = value;
+		if( (uint64_t)( end - s ) < item->length )
+			return setJSONError( err, JSON_INCOMPLETE, "incomplete MessagePack value\n" );
+		item->data = s;
+		s += item->length;
+		break;
+	case MSGPACK_ARRAY:
+	case MSGPACK_MAP:
+		item->length = value;
+		break;
+	}
+	*next = s;
+	return JSON_OK;
+}
+
+/* writes a length in the smallest of the three sized forms of a type (whose codes are
+   consecutive from first), after its fixed form if it has one */
+size_t writeMsgPackLength( size_t length, int fixed, size_t fixed_max, int first, int min_size, unsigned char* out )
+{
+	if( fixed >= 0 && length <= fixed_max ) {
+		out[0] = fixed | length;
+		return 1;
+	}
+	for( int size = min_size, code = first; size <= 4; size *= 2, code++ ) {
+		if( (uint64_t)length <= ( (uint64_t)1 << ( 8 * size ) ) - 1 ) {
+			out[0] = code;
+			writeBigEndian( length, size, out + 1 );
+			return 1 + size;
+		}
+	}
+	return 0;
+}
+
+size_t writeMsgPackHeader( int type, size_t length, unsigned char* out )
+{
+	switch( type ) {
+	case MSGPACK_NIL:
+		out[0] = 0xC0;
+		return 1;
+	case MSGPACK_BOOLEAN:
+		out[0] = length ? 0xC3 : 0xC2;
+		return 1;
+	case MSGPACK_STRING:
+		return writeMsgPackLength( length, 0xA0, 31, 0xD9, 1, out );
+	case MSGPACK_BINARY:
+		return writeMsgPackLength( length, -1, 0, 0xC4, 1, out );
+	case MSGPACK_ARRAY:
+		return writeMsgPackLength( length, 0x90, 15, 0xDC, 2, out );
+	case MSGPACK_MAP:
+		return writeMsgPackLength( length, 0x80, 15, 0xDE, 2, out );
+	}
+	return 0;
+}
+
+size_t writeMsgPackInteger( long long value, unsigned char* out )
+{
+	int log_size; /* of 1, 2, 4 or 8 bytes */
+	if( value >= -32 && value <= 127 ) {
+		out[0] = (unsigned char)( value & 0xFF );
+		return 1;
+	}
+	if( value >= 0 ) {
+		log_size = value <= 0xFF ? 0 : value <= 0xFFFF ? 1 : value <= 0xFFFFFFFFLL ? 2 : 3;
+		out[0] = 0xCC + log_size;
+	}
+	else {
+		log_size = value >= -0x80 ? 0 : value >= -0x8000 ? 1 : value >= -0x80000000LL ? 2 : 3;
+		out[0] = 0xD0 + log_size;
+	}
+	writeBigEndian( (uint64_t)value, 1 << log_size, out + 1 );
+	return 1 + ( 1 << log_size );
+}
+
+size_t writeMsgPackDouble( double value, unsigned char* out )
+{
+	uint64_t bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+	out[0] = 0xCB;
+	writeBigEndian( bits, 8, out + 1 );
+	return 9;
+}
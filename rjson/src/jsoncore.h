@@ -0,0 +1,165 @@
+#ifndef RJSON_JSONCORE_H
+#define RJSON_JSONCORE_H
+
+/* The R independent core of the parser: scanning, validation, string unescaping and escaping, and
+   building tapes. Nothing here uses the R API, so it can also be built into native benchmark and
+   fuzzing drivers (see native/ at the top of the repository). The R bindings are in parser.c. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_OK 0
+#define JSON_ERROR 1
+#define JSON_INCOMPLETE 2 /* the input ended too early; more input may complete it */
+
+typedef struct JSONError
+{
+	int code;
+	char message[256];
+} JSONError;
+
+int setJSONError( JSONError* err, int code, const char* format, ... );
+
+#define UNEXPECTED_ESCAPE_ERROR 1 /* issue an error and stop */
+#define UNEXPECTED_ESCAPE_SKIP 2 /* skip the unexpected char and move to the next character */
+#define UNEXPECTED_ESCAPE_KEEP 3 /* include the unexpected char as a regular char and continue */
+
+#define INVALID_UTF8_ERROR 1 /* issue an error and stop */
+#define INVALID_UTF8_REPLACE 2 /* replace each invalid byte with U+FFFD */
+#define INVALID_UTF8_SKIP 3 /* drop invalid bytes */
+
+/* How strings are unescaped, and where into. reserve returns a buffer of at least size bytes,
+   keeping the contents of the previous buffer; warn (which may be NULL) reports unexpected
+   escapes which are skipped or kept. cancelled (which may also be NULL) is polled while a tape is
+   built, which stops with an error once it returns non-zero. */
+typedef struct JSONStringOptions
+{
+	int unexpected_escape_behavior;
+	int invalid_utf8_behavior;
+	char* ( *reserve )( void* ctx, size_t size );
+	void ( *warn )( void* ctx, const char* message );
+	void* ctx;
+	int ( *cancelled )( void* ctx );
+} JSONStringOptions;
+
+/* UTF-8 */
+int UTF8EncodeUnicode( unsigned long input, char* s );
+int parseUTF16Sequence( const char* s, int i, unsigned long* unicode );
+size_t asciiPrefixLength( const unsigned char* s, size_t n );
+int utf8SequenceLength( const unsigned char* s, size_t n );
+
+/* Scalars. Each returns JSON_OK, or the code of the error it describes in err. */
+int scanJSONNull( const char* s, const char** next_ch, JSONError* err );
+int scanJSONTrue( const char* s, const char** next_ch, JSONError* err );
+int scanJSONFalse( const char* s, const char** next_ch, JSONError* err );
+int skipJSONNumber( const char* s, const char** next_ch, JSONError* err );
+int scanJSONNumber( const char* s, const char** next_ch, double* value, JSONError* err );
+int scanJSONInteger( const char* s, const char* end, long long* value );
+
+/* Unescapes the string starting at the quote s into the reserved buffer, which is '\0'
+   terminated and *len bytes long. */
+int unescapeJSONString( const char* s,
+						const char** next_ch,
+						const JSONStringOptions* options,
+						size_t* len,
+						JSONError* err );
+
+/* Validates a value and sets next_ch past it. Escape sequences and UTF-8 inside strings are not
+   checked. */
+int skipJSONValue( const char* s, const char** next_ch, JSONError* err );
+
+/* A tape indexes a document by byte offsets into its text. It holds a node for the top level
+   value and for every array or object in it, in preorder (so by increasing offset); scalars are
+   not recorded, and are found from the text with getJSONTapeChildren. */
+typedef struct JSONTapeNode
+{
+	size_t offset; /* first character of the value */
+	size_t end; /* just past the value */
+	ptrdiff_t next; /* first node after this value's subtree */
+	ptrdiff_t length; /* number of children of an array or object */
+} JSONTapeNode;
+
+typedef struct JSONTape
+{
+	JSONTapeNode* nodes; /* malloc'd; release with freeJSONTape */
+	ptrdiff_t n_nodes;
+	ptrdiff_t size;
+	ptrdiff_t n_values; /* values validated, scalars included */
+} JSONTape;
+
+/* Fully validates the value at text (strings are unescaped, and discarded) and appends it to
+   tape, which must be zero initialized or hold an earlier document. */
+int buildJSONTape( const char* text,
+				   const char** next_ch,
+				   JSONTape* tape,
+				   const JSONStringOptions* options,
+				   JSONError* err );
+void freeJSONTape( JSONTape* tape );
+
+/* Writes the offset of each child of the array or object at tape node `node` to offsets, which
+   must hold nodes[node].length entries. For objects, the offset is that of the key's opening
+   quote, and skipJSONKey finds the value. text must be the text the tape was built from. */
+void getJSONTapeChildren( const char* text, const JSONTape* tape, ptrdiff_t node, size_t* offsets );
+const char* skipJSONKey( const char* key );
+
+/* Writes the quoted, escaped form of the '\0' terminated UTF-8 string s to out, which must hold
+   at least JSON_ESCAPED_SIZE( strlen( s ) ) bytes. Every non-ASCII character is written as a
+   \u escape. Returns the number of bytes written, or -1 if s is not UTF-8. */
+#define JSON_ESCAPED_SIZE( n ) ( 6 * ( n ) + 2 )
+ptrdiff_t escapeJSONString( const char* s, char* out );
+
+/* Base64 (RFC 4648), as used for raw vectors. encodeBase64 writes JSON_BASE64_SIZE( n ) padded
+   characters, without a terminating '\0'. decodeBase64 accepts unpadded input, and writes
+   base64DecodedSize( s, n ) bytes; it returns their number, or -1 if s is not base64. */
+#define JSON_BASE64_SIZE( n ) ( 4 * ( ( ( n ) + 2 ) / 3 ) )
+size_t encodeBase64( const unsigned char* s, size_t n, char* out );
+size_t base64DecodedSize( const char* s, size_t n );
+ptrdiff_t decodeBase64( const char* s, size_t n, unsigned char* out );
+
+/* Copies n bytes of a string which is not escaped (such as a MessagePack string) into the
+   reserved buffer, checking they are UTF-8; as for unescapeJSONString, the buffer is '\0'
+   terminated and *len bytes long. */
+int copyJSONString( const char* s, size_t n, const JSONStringOptions* options, size_t* len, JSONError* err );
+
+/* MessagePack, which holds the same values as JSON in a binary form. scanMsgPackItem reads the
+   item at s (before end): scalars completely, strings and binaries up to the end of their bytes
+   (which data points to), and arrays and maps up to their first element. */
+#define MSGPACK_NIL 0
+#define MSGPACK_BOOLEAN 1
+#define MSGPACK_INTEGER 2 /* unsigned integers beyond the range of long long are MSGPACK_UNSIGNED */
+#define MSGPACK_FLOAT 3
+#define MSGPACK_STRING 4
+#define MSGPACK_BINARY 5
+#define MSGPACK_ARRAY 6
+#define MSGPACK_MAP 7
+#define MSGPACK_UNSIGNED 8
+
+typedef struct MsgPackItem
+{
+	int type;
+	union
+	{
+		int boolean;
+		long long integer;
+		uint64_t unsigned_integer;
+		double number;
+	} u;
+	size_t length; /* bytes of a string or binary, elements of an array, or key/value pairs of a map */
+	const unsigned char* data;
+} MsgPackItem;
+
+int scanMsgPackItem( const unsigned char* s,
+					 const unsigned char* end,
+					 const unsigned char** next,
+					 MsgPackItem* item,
+					 JSONError* err );
+
+/* Each writes the smallest encoding of an item to out, which must hold MSGPACK_MAX_HEADER bytes,
+   and returns its size. writeMsgPackHeader writes nil, booleans (whose value is length), and the
+   headers of strings, binaries, arrays and maps; it returns 0 if length needs more than 32 bits. */
+#define MSGPACK_MAX_HEADER 9
+size_t writeMsgPackHeader( int type, size_t length, unsigned char* out );
+size_t writeMsgPackInteger( long long value, unsigned char* out );
+size_t writeMsgPackDouble( double value, unsigned char* out );
+
+#endif
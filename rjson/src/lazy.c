@@ -0,0 +1,300 @@
+#include <R.h>
+#include <Rdefines.h>
+
+#include "funcs.h"
+#include "parser.h"
+
+/* Lazily parsed documents. The document is validated once by the core's buildJSONTape, which
+   indexes its arrays and objects in a flat, preorder tape of byte offsets into the (unchanged)
+   input string; no R objects are created. Handles refer to a single node of the tape. The offsets
+   of a container's children are found the first time it is accessed, so selecting a child by
+   position takes constant time, and only the values which are actually accessed are parsed, by
+   the regular parser, from their offset. */
+
+#define LAZY_TAG "rjson_lazy"
+#define LAZY_CLASS "rjson_lazy"
+
+typedef struct LazyDocument
+{
+	const char* text; /* the input CHARSXP, which the external pointer keeps alive */
+	JSONTape tape;
+	size_t** children; /* per tape node, the offsets from getJSONTapeChildren, once accessed */
+	ParseOptions parse_options; /* arena is set for the duration of each call */
+} LazyDocument;
+
+void lazyFinalizer( SEXP ptr )
+{
+	LazyDocument* doc = (LazyDocument*)R_ExternalPtrAddr( ptr );
+	if( doc == NULL )
+		return;
+	if( doc->children ) {
+		for( ptrdiff_t i = 0; i < doc->tape.n_nodes; i++ )
+			free( doc->children[i] );
+		free( doc->children );
+	}
+	freeJSONTape( &doc->tape );
+	free( doc );
+	R_ClearExternalPtr( ptr );
+}
+
+SEXP mkLazyHandle( SEXP ptr, R_xlen_t node )
+{
+	SEXP handle, classp;
+	PROTECT( handle = ScalarReal( (double)node ) );
+	setAttrib( handle, install( "document" ), ptr );
+	PROTECT( classp = mkString( LAZY_CLASS ) );
+	SET_CLASS( handle, classp );
+	UNPROTECT( 2 );
+	return handle;
+}
+
+LazyDocument* getLazyDocument( SEXP handle, R_xlen_t* node )
+{
+	SEXP ptr = getAttrib( handle, install( "document" ) );
+	if( TYPEOF( handle ) != REALSXP || TYPEOF( ptr ) != EXTPTRSXP ||
+		R_ExternalPtrTag( ptr ) != install( LAZY_TAG ) )
+		Rf_error( "document must be created by parseJSONLazy\n" );
+	LazyDocument* doc = (LazyDocument*)R_ExternalPtrAddr( ptr );
+	if( doc == NULL )
+		Rf_error( "document is no longer valid; call parseJSONLazy again\n" );
+	*node = (R_xlen_t)REAL( handle )[0];
+	if( *node < 0 || *node >= doc->tape.n_nodes )
+		Rf_error( "invalid document handle\n" );
+	return doc;
+}
+
+int isLazyContainer( const LazyDocument* doc, R_xlen_t node )
+{
+	char c = doc->text[doc->tape.nodes[node].offset];
+	return c == '[' || c == '{';
+}
+
+/* the offsets of a container's children, found on first use */
+const size_t* getLazyChildren( LazyDocument* doc, R_xlen_t node )
+{
+	if( doc->children[node] == NULL ) {
+		size_t length = doc->tape.nodes[node].length;
+		size_t* offsets = (size_t*)malloc( ( length > 0 ? length : 1 ) * sizeof( size_t ) );
+		if( offsets == NULL )
+			Rf_error( "unable to allocate lazy JSON index\n" );
+		getJSONTapeChildren( doc->text, &doc->tape, node, offsets );
+		doc->children[node] = offsets;
+	}
+	return doc->children[node];
+}
+
+/* the tape node of the array or object at offset; nodes are in order of their offsets */
+R_xlen_t findLazyNode( const LazyDocument* doc, size_t offset )
+{
+	R_xlen_t lo = 0, hi = doc->tape.n_nodes - 1;
+	while( lo < hi ) {
+		R_xlen_t mid = lo + ( hi - lo ) / 2;
+		if( doc->tape.nodes[mid].offset < offset )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Validates str and builds its tape; returns a handle to the top level value */
+SEXP parseJSONLazy( SEXP str_in, SEXP options )
+{
+	SEXP ptr, text, p;
+	const char* next_ch;
+	ParseArena arena;
+
+	if( !isString( str_in ) || XLENGTH( str_in ) != 1 || STRING_ELT( str_in, 0 ) == NA_STRING )
+		Rf_error( "json_str must be a single string\n" );
+	text = STRING_ELT( str_in, 0 );
+
+	LazyDocument* doc = (LazyDocument*)calloc( 1, sizeof( LazyDocument ) );
+	if( doc == NULL )
+		Rf_error( "unable to allocate lazy JSON document\n" );
+	PROTECT( ptr = R_MakeExternalPtr( doc, install( LAZY_TAG ), text ) );
+	R_RegisterCFinalizerEx( ptr, lazyFinalizer, TRUE );
+
+	doc->text = CHAR( text );
+	readParseOptions( options, &doc->parse_options );
+
+	JSONStringOptions string_options;
+	JSONError err;
+	initParseArena( &arena );
+	doc->parse_options.arena = &arena;
+	getStringOptions( &doc->parse_options, &string_options );
+	if( buildJSONTape( doc->text, &next_ch, &doc->tape, &string_options, &err ) != JSON_OK )
+		p = mkCoreError( &err );
+	else
+		p = NULL;
+	doc->parse_options.arena = NULL;
+
+	if( p == NULL ) {
+		while( *next_ch == ' ' || *next_ch == '\t' || *next_ch == '\n' || *next_ch == '\r' )
+			next_ch++;
+		if( *next_ch != '\0' )
+			p = mkError( "not all data was parsed (%d chars were parsed out of a total of %d chars)",
+						 (int)( next_ch - doc->text ),
+						 (int)strlen( doc->text ) );
+	}
+	if( p != NULL ) {
+		/* no handle refers to the tape, so release it straight away */
+		lazyFinalizer( ptr );
+		UNPROTECT( 1 + PARSE_ARENA_PROTECT_COUNT );
+		return p;
+	}
+
+	/* give back the unused part of the tape */
+	JSONTapeNode* nodes =
+		(JSONTapeNode*)realloc( doc->tape.nodes, doc->tape.n_nodes * sizeof( JSONTapeNode ) );
+	if( nodes != NULL ) {
+		doc->tape.nodes = nodes;
+		doc->tape.size = doc->tape.n_nodes;
+	}
+	doc->children = (size_t**)calloc( doc->tape.n_nodes, sizeof( size_t* ) );
+	if( doc->children == NULL ) {
+		lazyFinalizer( ptr );
+		Rf_error( "unable to allocate lazy JSON index\n" );
+	}
+
+	p = mkLazyHandle( ptr, 0 );
+	UNPROTECT( 1 + PARSE_ARENA_PROTECT_COUNT );
+	return p;
+}
+
+/* parses the value at an offset into an R object, exactly as fromJSON would */
+SEXP materializeLazyValue( LazyDocument* doc, size_t offset )
+{
+	const char* next_ch;
+	ParseArena arena;
+	SEXP p;
+
+	initParseArena( &arena );
+	doc->parse_options.arena = &arena;
+	p = parseValue( doc->text + offset, &next_ch, &doc->parse_options );
+	doc->parse_options.arena = NULL;
+	UNPROTECT( PARSE_ARENA_PROTECT_COUNT );
+	return p;
+}
+
+/* Returns a key, given the offset of its opening quote, as a CHARSXP. Keys were validated when
+   the tape was built. */
+SEXP lazyKey( LazyDocument* doc, size_t key_offset, ParseArena* arena )
+{
+	const char* next_ch;
+	SEXP key;
+	doc->parse_options.arena = arena;
+	key = parseStringChar( doc->text + key_offset, &next_ch, &doc->parse_options );
+	doc->parse_options.arena = NULL;
+	return key;
+}
+
+/* compares a key to a UTF-8 string, unescaping it only if it contains escape sequences */
+int lazyKeyEquals( LazyDocument* doc, size_t key_offset, const char* name, size_t name_len, ParseArena* arena )
+{
+	const char* key = doc->text + key_offset + 1;
+	const char* end = key;
+	while( *end != '"' && *end != '\\' )
+		end++;
+	if( *end == '"' )
+		return (size_t)( end - key ) == name_len && memcmp( key, name, name_len ) == 0;
+	return strcmp( CHAR( lazyKey( doc, key_offset, arena ) ), name ) == 0;
+}
+
+/* Returns a child of an array or object, selected by its (1 based) position, or by its key.
+   Containers are returned as handles, and everything else is parsed. Unknown keys give NULL. */
+SEXP lazyGet( SEXP handle, SEXP i )
+{
+	R_xlen_t node;
+	LazyDocument* doc = getLazyDocument( handle, &node );
+	SEXP ptr = getAttrib( handle, install( "document" ) );
+	R_xlen_t length = doc->tape.nodes[node].length;
+	int is_object = doc->text[doc->tape.nodes[node].offset] == '{';
+	R_xlen_t k;
+
+	if( !isLazyContainer( doc, node ) )
+		Rf_error( "subscript out of bounds\n" );
+	if( XLENGTH( i ) != 1 )
+		Rf_error( "subscript must be a single position or name\n" );
+	const size_t* children = getLazyChildren( doc, node );
+
+	if( isString( i ) ) {
+		if( !is_object || STRING_ELT( i, 0 ) == NA_STRING )
+			return R_NilValue;
+		const char* name = translateCharUTF8( STRING_ELT( i, 0 ) );
+		size_t name_len = strlen( name );
+		ParseArena arena;
+		initParseArena( &arena );
+		for( k = 0; k < length; k++ ) {
+			if( lazyKeyEquals( doc, children[k], name, name_len, &arena ) )
+				break;
+		}
+		UNPROTECT( PARSE_ARENA_PROTECT_COUNT );
+		if( k == length )
+			return R_NilValue;
+	}
+	else {
+		double position = asReal( i );
+		if( ISNAN( position ) || position < 1 || position > length )
+			Rf_error( "subscript out of bounds\n" );
+		k = (R_xlen_t)position - 1;
+	}
+
+	const char* value = doc->text + children[k];
+	if( is_object )
+		value = skipJSONKey( value );
+	if( *value == '[' || *value == '{' )
+		return mkLazyHandle( ptr, findLazyNode( doc, value - doc->text ) );
+	return materializeLazyValue( doc, value - doc->text );
+}
+
+/* the number of children of an array or object, or 1 for anything else */
+SEXP lazyLength( SEXP handle )
+{
+	R_xlen_t node;
+	LazyDocument* doc = getLazyDocument( handle, &node );
+	if( !isLazyContainer( doc, node ) )
+		return ScalarReal( 1 );
+	return ScalarReal( (double)doc->tape.nodes[node].length );
+}
+
+/* the keys of an object, or NULL */
+SEXP lazyNames( SEXP handle )
+{
+	R_xlen_t node;
+	LazyDocument* doc = getLazyDocument( handle, &node );
+	ParseArena arena;
+	SEXP names, key;
+
+	if( doc->text[doc->tape.nodes[node].offset] != '{' )
+		return R_NilValue;
+
+	R_xlen_t length = doc->tape.nodes[node].length;
+	const size_t* children = getLazyChildren( doc, node );
+	initParseArena( &arena );
+	PROTECT( names = allocVector( STRSXP, length ) );
+	for( R_xlen_t k = 0; k < length; k++ ) {
+		key = lazyKey( doc, children[k], &arena );
+		if( TYPEOF( key ) != CHARSXP )
+			Rf_error( "%s", CHAR( STRING_ELT( key, 0 ) ) );
+		SET_STRING_ELT( names, k, key );
+	}
+	UNPROTECT( 1 + PARSE_ARENA_PROTECT_COUNT );
+	return names;
+}
+
+/* the whole value of a node, as returned by fromJSON */
+SEXP lazyValue( SEXP handle )
+{
+	R_xlen_t node;
+	LazyDocument* doc = getLazyDocument( handle, &node );
+	return materializeLazyValue( doc, doc->tape.nodes[node].offset );
+}
+
+/* "array", "object", or "value" */
+SEXP lazyType( SEXP handle )
+{
+	R_xlen_t node;
+	LazyDocument* doc = getLazyDocument( handle, &node );
+	char c = doc->text[doc->tape.nodes[node].offset];
+	return mkString( c == '[' ? "array" : c == '{' ? "object" : "value" );
+}
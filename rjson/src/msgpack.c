@@ -0,0 +1,220 @@
+#include <R.h>
+#include <Rdefines.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "funcs.h"
+#include "parser.h"
+
+/* MessagePack decoding. Items are read by the core's scanMsgPackItem, and pushed onto the parse
+   arena as the elements parseElement pushes for JSON text; arrays and maps are then built by the
+   same popArray and popList, so simplification, names, null = "NA" and hash.threshold give the
+   same R values as parsing the JSON written by toJSON for the same object. The exception is raw
+   vectors: MessagePack binaries are read back as RAWSXP, where JSON has base64 strings. */
+
+SEXP parseMsgPackValue( const unsigned char* s,
+						const unsigned char* end,
+						const unsigned char** next,
+						const ParseOptions* parse_options );
+
+/* copies a string into the arena scratch buffer, and returns it as a CHARSXP (or an error) */
+SEXP parseMsgPackChar( const MsgPackItem* item, const ParseOptions* parse_options )
+{
+	JSONStringOptions options;
+	JSONError err;
+	size_t len;
+	getStringOptions( parse_options, &options );
+	if( copyJSONString( (const char*)item->data, item->length, &options, &len, &err ) != JSON_OK )
+		return mkCoreError( &err );
+	/* as in the JSON parser, an embedded '\0' ends the string */
+	return mkCharCE( parse_options->arena->scratch, CE_UTF8 );
+}
+
+/* pushes the decimal digits of an integer which is only exact as a string (bigint = "string") */
+void pushMsgPackDigits( ParseArena* arena, uint64_t magnitude, int negative )
+{
+	char digits[24];
+	int n = snprintf( digits, sizeof( digits ), "%s%llu", negative ? "-" : "", (unsigned long long)magnitude );
+	pushBigIntElement( arena, digits, digits + n );
+}
+
+/* Reads an item and pushes it onto the arena rather than returning it; scalars are stored
+   unboxed. Returns NULL on success, or the error. */
+SEXP parseMsgPackElement( const unsigned char* s,
+						  const unsigned char* end,
+						  const unsigned char** next,
+						  const ParseOptions* parse_options )
+{
+	ParseArena* arena = parse_options->arena;
+	MsgPackItem item;
+	JSONError err;
+	SEXP p;
+
+	if( scanMsgPackItem( s, end, next, &item, &err ) != JSON_OK )
+		return mkCoreError( &err );
+
+	switch( item.type ) {
+	case MSGPACK_NIL:
+		pushElement( arena, ELEMENT_NULL );
+		return NULL;
+	case MSGPACK_BOOLEAN:
+		pushElement( arena, ELEMENT_LOGICAL )->u.logical = item.u.boolean;
+		return NULL;
+	case MSGPACK_INTEGER:
+		/* as scanNumberElement does for integral numbers */
+		if( ( parse_options->integer || parse_options->bigint != BIGINT_DOUBLE ) &&
+			item.u.integer != NA_INTEGER64 )
+			pushElement( arena, ELEMENT_INTEGER )->u.integer = item.u.integer;
+		else if( parse_options->bigint == BIGINT_STRING )
+			pushMsgPackDigits( arena, -(uint64_t)item.u.integer, TRUE ); /* NA_integer64_ */
+		else
+			pushElement( arena, ELEMENT_NUMBER )->u.number = (double)item.u.integer;
+		return NULL;
+	case MSGPACK_UNSIGNED:
+		if( parse_options->bigint == BIGINT_STRING )
+			pushMsgPackDigits( arena, item.u.unsigned_integer, FALSE );
+		else
+			pushElement( arena, ELEMENT_NUMBER )->u.number = (double)item.u.unsigned_integer;
+		return NULL;
+	case MSGPACK_FLOAT:
+		pushElement( arena, ELEMENT_NUMBER )->u.number = item.u.number;
+		return NULL;
+	case MSGPACK_STRING:
+		p = parseMsgPackChar( &item, parse_options );
+		if( TYPEOF( p ) != CHARSXP )
+			return p;
+		pushStringElement( arena, p );
+		return NULL;
+	}
+
+	p = parseMsgPackValue( s, end, next, parse_options );
+	if( hasClass( p, TRYERROR_CLASS ) == TRUE )
+		return p;
+	pushSEXPElement( arena, p );
+	return NULL;
+}
+
+SEXP parseMsgPackArray( const MsgPackItem* item,
+						const unsigned char* s,
+						const unsigned char* end,
+						const unsigned char** next,
+						const ParseOptions* parse_options )
+{
+	ParseArenaMark mark = markParseArena( parse_options->arena );
+	SEXP err;
+
+	if( item->length == 0 ) {
+		*next = s;
+		return allocVector( VECSXP, 0 );
+	}
+	for( size_t i = 0; i < item->length; i++ ) {
+		if( ( err = parseMsgPackElement( s, end, next, parse_options ) ) != NULL )
+			return err;
+		s = *next;
+	}
+	return popArray( parse_options, mark, parse_options->simplify_lists );
+}
+
+SEXP parseMsgPackMap( const MsgPackItem* item,
+					  const unsigned char* s,
+					  const unsigned char* end,
+					  const unsigned char** next,
+					  const ParseOptions* parse_options )
+{
+	ParseArena* arena = parse_options->arena;
+	ParseArenaMark mark = markParseArena( arena );
+	MsgPackItem key_item;
+	JSONError core_err;
+	SEXP key, err;
+
+	if( item->length == 0 ) {
+		*next = s;
+		return allocVector( VECSXP, 0 );
+	}
+	for( size_t i = 0; i < item->length; i++ ) {
+		if( scanMsgPackItem( s, end, next, &key_item, &core_err ) != JSON_OK )
+			return mkCoreError( &core_err );
+		if( key_item.type != MSGPACK_STRING )
+			return mkError( "MessagePack map keys must be strings\n" );
+		key = parseMsgPackChar( &key_item, parse_options );
+		if( TYPEOF( key ) != CHARSXP )
+			return key;
+		pushStringElement( arena, key );
+		s = *next;
+
+		if( ( err = parseMsgPackElement( s, end, next, parse_options ) ) != NULL )
+			return err;
+		s = *next;
+	}
+	return popList( parse_options, mark );
+}
+
+/* reads an item (and, for arrays and maps, everything in it) and returns it as an R value */
+SEXP parseMsgPackValue( const unsigned char* s,
+						const unsigned char* end,
+						const unsigned char** next,
+						const ParseOptions* parse_options )
+{
+	MsgPackItem item;
+	JSONError err;
+	SEXP p;
+
+	/* nesting is only bounded by the input, so guard against running out of stack */
+	R_CheckStack();
+	if( scanMsgPackItem( s, end, next, &item, &err ) != JSON_OK )
+		return mkCoreError( &err );
+
+	switch( item.type ) {
+	case MSGPACK_ARRAY:
+		return parseMsgPackArray( &item, *next, end, next, parse_options );
+	case MSGPACK_MAP:
+		return parseMsgPackMap( &item, *next, end, next, parse_options );
+	case MSGPACK_BINARY:
+		p = allocVector( RAWSXP, item.length );
+		if( item.length > 0 )
+			memcpy( RAW( p ), item.data, item.length );
+		return p;
+	case MSGPACK_STRING:
+		p = parseMsgPackChar( &item, parse_options );
+		return TYPEOF( p ) == CHARSXP ? ScalarString( p ) : p;
+	}
+
+	ParseArenaMark mark = markParseArena( parse_options->arena );
+	ParseElement* e;
+	if( ( p = parseMsgPackElement( s, end, next, parse_options ) ) != NULL )
+		return p;
+	e = parse_options->arena->elements + mark.elements_top;
+	PROTECT( p = boxElement( parse_options, e ) );
+	resetParseArena( parse_options->arena, mark );
+	UNPROTECT( 1 );
+	return p;
+}
+
+/* Parses a raw vector holding a single MessagePack value */
+SEXP fromMsgPack( SEXP x, SEXP options )
+{
+	const unsigned char* s = RAW( x );
+	const unsigned char* end = s + XLENGTH( x );
+	const unsigned char* next = s;
+	ParseArena arena;
+	SEXP p;
+
+	ParseOptions parse_options;
+	readParseOptions( options, &parse_options );
+	parse_options.arena = &arena;
+
+	initParseArena( &arena );
+
+	if( s == end )
+		p = mkErrorWithClass( INCOMPLETE_CLASS, "no data to parse\n" );
+	else
+		p = parseMsgPackValue( s, end, &next, &parse_options );
+	PROTECT( p );
+	if( !hasClass( p, TRYERROR_CLASS ) && next != end )
+		p = mkError( "not all data was parsed (%.0f bytes were parsed out of a total of %.0f bytes)",
+					 (double)( next - s ),
+					 (double)( end - s ) );
+
+	UNPROTECT( 1 + PARSE_ARENA_PROTECT_COUNT );
+	return p;
+}
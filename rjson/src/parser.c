@@ -1,40 +1,14 @@
 #include <R.h>
 #include <Rdefines.h>
+#include <math.h>
+#include <string.h>
 
-#define DEFAULT_VECTOR_START_SIZE                                                                  \
-	10 /* allocate vectors this size to start with, then grow them as needed */
-#define MAX_NUMBER_BUF 256
+#include "parser.h"
 
-#define UNEXPECTED_ESCAPE_ERROR 1 /* issue an error and stop */
-#define UNEXPECTED_ESCAPE_SKIP 2 /* skip the unexpected char and move to the next character */
-#define UNEXPECTED_ESCAPE_KEEP 3 /* include the unexpected char as a regular char and continue */
+#define DEFAULT_SCRATCH_START_SIZE 256 /* initial size of the string unescaping buffer */
+#define DEFAULT_STACK_START_SIZE                                                                   \
+	256 /* initial number of pending container elements, grown geometrically as needed */
 
-#define MASKBITS 0x3F
-#define MASKBYTE 0x80
-#define MASK2BYTES 0xC0
-#define MASK3BYTES 0xE0
-#define MASK4BYTES 0xF0
-
-typedef struct ParseOptions
-{
-	int unexpected_escape_behavior;
-	int simplify_lists;
-} ParseOptions;
-
-SEXP parseValue( const char* s, const char** next_ch, const ParseOptions* parse_options );
-SEXP parseNull( const char* s, const char** next_ch, const ParseOptions* parse_options );
-SEXP parseTrue( const char* s, const char** next_ch, const ParseOptions* parse_options );
-SEXP parseFalse( const char* s, const char** next_ch, const ParseOptions* parse_options );
-SEXP parseString( const char* s, const char** next_ch, const ParseOptions* parse_options );
-SEXP parseNumber( const char* s, const char** next_ch, const ParseOptions* parse_options );
-SEXP parseArray( const char* s, const char** next_ch, const ParseOptions* parse_options );
-SEXP parseList( const char* s, const char** next_ch, const ParseOptions* parse_options );
-
-SEXP mkError( const char* format, ... );
-
-int getUnexpectedEscapeHandlingCode( const char* s );
-
-#define TRYERROR_CLASS "try-error"
 SEXP mkError( const char* format, ... )
 {
 	SEXP p, classp;
@@ -53,7 +27,6 @@ SEXP mkError( const char* format, ... )
 	return p;
 }
 
-#define INCOMPLETE_CLASS "incomplete"
 SEXP addClass( SEXP p, const char* class )
 {
 	SEXP class_p;
@@ -84,9 +57,9 @@ SEXP mkErrorWithClass( const char* class, const char* format, ... )
 	vsnprintf( buf, 256, format, args );
 	va_end( args );
 
-	PROTECT( p = allocVector( STRSXP, 2 ) );
+	PROTECT( p = allocVector( STRSXP, 1 ) );
 	SET_STRING_ELT( p, 0, mkCharCE( buf, CE_UTF8 ) );
-	PROTECT( classp = allocVector( STRSXP, 1 ) );
+	PROTECT( classp = allocVector( STRSXP, 2 ) );
 	SET_STRING_ELT( classp, 0, mkChar( TRYERROR_CLASS ) );
 	SET_STRING_ELT( classp, 1, mkChar( class ) );
 	SET_CLASS( p, classp );
@@ -111,104 +84,694 @@ int hasClass( SEXP p, const char* class )
 	return FALSE;
 }
 
-int UTF8EncodeUnicode( unsigned long input, char* s )
+int getUnexpectedEscapeHandlingCode( const char* s )
+{
+	if( s != NULL ) {
+		if( strcmp( s, "skip" ) == 0 ) {
+			return UNEXPECTED_ESCAPE_SKIP;
+		}
+		else if( strcmp( s, "keep" ) == 0 ) {
+			return UNEXPECTED_ESCAPE_KEEP;
+		}
+	}
+	/* in all other cases, just use the standard original error */
+	return UNEXPECTED_ESCAPE_ERROR;
+}
+
+int getInvalidUTF8HandlingCode( const char* s )
+{
+	if( s != NULL ) {
+		if( strcmp( s, "replace" ) == 0 )
+			return INVALID_UTF8_REPLACE;
+		if( strcmp( s, "skip" ) == 0 )
+			return INVALID_UTF8_SKIP;
+	}
+	return INVALID_UTF8_ERROR;
+}
+
+/* converts an error from the R independent core into a try-error */
+SEXP mkCoreError( const JSONError* err )
+{
+	if( err->code == JSON_INCOMPLETE )
+		return mkErrorWithClass( INCOMPLETE_CLASS, "%s", err->message );
+	return mkError( "%s", err->message );
+}
+
+char* reserveArenaScratch( void* ctx, size_t size )
+{
+	return reserveScratch( (ParseArena*)ctx, size );
+}
+
+void warnUnexpectedEscape( void* ctx, const char* message )
+{
+	Rf_warning( "%s", message );
+}
+
+void initParseArena( ParseArena* arena )
+{
+	arena->scratch = R_alloc( DEFAULT_SCRATCH_START_SIZE, 1 );
+	arena->scratch_size = DEFAULT_SCRATCH_START_SIZE;
+
+	arena->elements =
+		(ParseElement*)R_alloc( DEFAULT_STACK_START_SIZE, sizeof( ParseElement ) );
+	arena->elements_size = DEFAULT_STACK_START_SIZE;
+	arena->elements_top = 0;
+
+	/* the caller is responsible for UNPROTECT( PARSE_ARENA_PROTECT_COUNT ) */
+	PROTECT_WITH_INDEX( arena->strings = allocVector( STRSXP, DEFAULT_STACK_START_SIZE ),
+						&arena->strings_index );
+	arena->strings_top = 0;
+	PROTECT_WITH_INDEX( arena->values = allocVector( VECSXP, DEFAULT_STACK_START_SIZE ),
+						&arena->values_index );
+	arena->values_top = 0;
+}
+
+/* returns the scratch buffer, grown (with its contents preserved) to hold at least size bytes */
+char* reserveScratch( ParseArena* arena, size_t size )
+{
+	if( size > arena->scratch_size ) {
+		size_t new_size = 2 * arena->scratch_size;
+		if( new_size < size )
+			new_size = size;
+		char* scratch = R_alloc( new_size, 1 );
+		memcpy( scratch, arena->scratch, arena->scratch_size );
+		arena->scratch = scratch;
+		arena->scratch_size = new_size;
+	}
+	return arena->scratch;
+}
+
+ParseElement* pushElement( ParseArena* arena, int kind )
+{
+	if( arena->elements_top >= arena->elements_size ) {
+		ParseElement* elements =
+			(ParseElement*)R_alloc( 2 * arena->elements_size, sizeof( ParseElement ) );
+		memcpy( elements, arena->elements, arena->elements_size * sizeof( ParseElement ) );
+		arena->elements = elements;
+		arena->elements_size *= 2;
+	}
+	ParseElement* e = &arena->elements[arena->elements_top++];
+	e->kind = kind;
+	return e;
+}
+
+void pushStringElement( ParseArena* arena, SEXP ch )
+{
+	R_xlen_t size = XLENGTH( arena->strings );
+	if( arena->strings_top >= size ) {
+		PROTECT( ch );
+		SEXP strings = allocVector( STRSXP, 2 * size );
+		for( R_xlen_t i = 0; i < size; i++ )
+			SET_STRING_ELT( strings, i, STRING_ELT( arena->strings, i ) );
+		REPROTECT( arena->strings = strings, arena->strings_index );
+		UNPROTECT( 1 ); /* ch */
+	}
+	SET_STRING_ELT( arena->strings, arena->strings_top, ch );
+	pushElement( arena, ELEMENT_STRING )->u.index = arena->strings_top++;
+}
+
+/* pushes the digits of an integral number from s to end */
+void pushBigIntElement( ParseArena* arena, const char* s, const char* end )
+{
+	pushStringElement( arena, mkCharLenCE( s, (int)( end - s ), CE_UTF8 ) );
+	arena->elements[arena->elements_top - 1].kind = ELEMENT_BIGINT;
+}
+
+void pushSEXPElement( ParseArena* arena, SEXP p )
+{
+	R_xlen_t size = XLENGTH( arena->values );
+	if( arena->values_top >= size ) {
+		PROTECT( p );
+		SEXP values = allocVector( VECSXP, 2 * size );
+		for( R_xlen_t i = 0; i < size; i++ )
+			SET_VECTOR_ELT( values, i, VECTOR_ELT( arena->values, i ) );
+		REPROTECT( arena->values = values, arena->values_index );
+		UNPROTECT( 1 ); /* p */
+	}
+	SET_VECTOR_ELT( arena->values, arena->values_top, p );
+	pushElement( arena, ELEMENT_SEXP )->u.index = arena->values_top++;
+}
+
+ParseArenaMark markParseArena( const ParseArena* arena )
+{
+	ParseArenaMark mark;
+	mark.elements_top = arena->elements_top;
+	mark.strings_top = arena->strings_top;
+	mark.values_top = arena->values_top;
+	return mark;
+}
+
+void resetParseArena( ParseArena* arena, ParseArenaMark mark )
+{
+	arena->elements_top = mark.elements_top;
+	arena->strings_top = mark.strings_top;
+	arena->values_top = mark.values_top;
+}
+
+/* classes used to pick the simplest vector type able to hold every element of an array */
+#define CLASS_LIST 0
+#define CLASS_LOGICAL 1
+#define CLASS_STRING 2
+#define CLASS_INT32 3 /* integral, and fits in an R integer */
+#define CLASS_INT53 4 /* integral, and exactly representable as a double */
+#define CLASS_INT64 5 /* integral, but only exactly representable in 64 bits */
+#define CLASS_REAL 6
+#define CLASS_NULL 7 /* a list element, unless nulls are read as NA */
+
+#define MAX_EXACT_DOUBLE_INTEGER 9007199254740992LL /* 2^53 */
+
+int getIntegerClass( long long value )
 {
-	/* 0xxxxxxx */
-	if( input < 0x80 ) {
-		s[0] = input;
-		return 1;
+	if( value > INT_MIN && value <= INT_MAX )
+		return CLASS_INT32;
+	if( value >= -MAX_EXACT_DOUBLE_INTEGER && value <= MAX_EXACT_DOUBLE_INTEGER )
+		return CLASS_INT53;
+	return CLASS_INT64;
+}
+
+int getElementClass( const ParseArena* arena, const ParseElement* e )
+{
+	switch( e->kind ) {
+	case ELEMENT_NULL:
+		return CLASS_NULL;
+	case ELEMENT_LOGICAL:
+		return CLASS_LOGICAL;
+	case ELEMENT_NUMBER:
+		return CLASS_REAL;
+	case ELEMENT_INTEGER:
+		return getIntegerClass( e->u.integer );
+	case ELEMENT_BIGINT:
+		return CLASS_INT64;
+	case ELEMENT_STRING:
+		return CLASS_STRING;
+	case ELEMENT_SEXP: {
+		SEXP p = VECTOR_ELT( arena->values, e->u.index );
+		if( GET_LENGTH( p ) != 1 )
+			return CLASS_LIST;
+		switch( TYPEOF( p ) ) {
+		case LGLSXP:
+			return CLASS_LOGICAL;
+		case INTSXP:
+			return CLASS_INT32;
+		case REALSXP:
+			return inherits( p, "integer64" ) ? CLASS_INT64 : CLASS_REAL;
+		case STRSXP:
+			return CLASS_STRING;
+		}
 	}
-	/* 110xxxxx 10xxxxxx */
-	else if( input < 0x800 ) {
-		s[0] = ( MASK2BYTES | ( input >> 6 ) );
-		s[1] = ( MASKBYTE | ( input & MASKBITS ) );
-		return 2;
 	}
-	/* 1110xxxx 10xxxxxx 10xxxxxx */
-	else if( input < 0x10000 ) {
-		s[0] = ( MASK3BYTES | ( input >> 12 ) );
-		s[1] = ( MASKBYTE | ( ( input >> 6 ) & MASKBITS ) );
-		s[2] = ( MASKBYTE | ( input & MASKBITS ) );
-		return 3;
+	return CLASS_LIST;
+}
+
+SEXP mkInteger64( R_xlen_t n )
+{
+	SEXP p;
+	PROTECT( p = allocVector( REALSXP, n ) );
+	SET_CLASS( p, mkString( "integer64" ) );
+	UNPROTECT( 1 );
+	return p;
+}
+
+/* reads the value of a numeric element as an exact 64 bit integer */
+long long getElementInteger64( const ParseArena* arena, const ParseElement* e )
+{
+	long long value;
+	if( e->kind == ELEMENT_INTEGER )
+		return e->u.integer;
+	SEXP p = VECTOR_ELT( arena->values, e->u.index );
+	if( TYPEOF( p ) == INTSXP )
+		return INTEGER( p )[0] == NA_INTEGER ? NA_INTEGER64 : INTEGER( p )[0];
+	memcpy( &value, REAL( p ), sizeof( value ) ); /* integer64 */
+	return value;
+}
+
+double getElementDouble( const ParseArena* arena, const ParseElement* e )
+{
+	if( e->kind == ELEMENT_NUMBER )
+		return e->u.number;
+	if( e->kind == ELEMENT_INTEGER )
+		return (double)e->u.integer;
+	SEXP p = VECTOR_ELT( arena->values, e->u.index );
+	if( TYPEOF( p ) == INTSXP )
+		return INTEGER( p )[0] == NA_INTEGER ? NA_REAL : INTEGER( p )[0];
+	return REAL( p )[0];
+}
+
+/* picks the vector type for an array of numbers, given the widest integer class seen.
+   Returns VECSXP if no single type can hold every value exactly, and sets is_integer64 when
+   the REALSXP result should hold 64 bit integers. */
+SEXPTYPE getNumberType( const ParseOptions* parse_options,
+						int has_real,
+						int integer_class,
+						int* is_integer64 )
+{
+	*is_integer64 = FALSE;
+	if( integer_class == CLASS_INT64 && parse_options->bigint != BIGINT_DOUBLE ) {
+		if( has_real )
+			return VECSXP;
+		if( parse_options->bigint == BIGINT_STRING )
+			return STRSXP;
+		*is_integer64 = TRUE;
+		return REALSXP;
 	}
-	/* 11110xxx 10xxxxxx 10xxxxxx 10xxxxxx */
-	else {
-		s[0] = ( MASK4BYTES | ( input >> 18 ) );
-		s[1] = ( MASKBYTE | ( ( input >> 12 ) & MASKBITS ) );
-		s[2] = ( MASKBYTE | ( ( input >> 6 ) & MASKBITS ) );
-		s[3] = ( MASKBYTE | ( input & MASKBITS ) );
-		return 4;
+	if( integer_class == CLASS_INT32 && !has_real && parse_options->integer )
+		return INTSXP;
+	return REALSXP;
+}
+
+/* converts a pending element into a standalone R value */
+SEXP boxElement( const ParseOptions* parse_options, const ParseElement* e )
+{
+	const ParseArena* arena = parse_options->arena;
+	int is_integer64;
+	char buf[32];
+
+	switch( e->kind ) {
+	case ELEMENT_LOGICAL:
+		return ScalarLogical( e->u.logical );
+	case ELEMENT_NUMBER:
+		return ScalarReal( e->u.number );
+	case ELEMENT_INTEGER:
+		switch( getNumberType(
+			parse_options, FALSE, getIntegerClass( e->u.integer ), &is_integer64 ) ) {
+		case INTSXP:
+			return ScalarInteger( (int)e->u.integer );
+		case STRSXP:
+			snprintf( buf, sizeof( buf ), "%lld", e->u.integer );
+			return mkString( buf );
+		}
+		if( is_integer64 ) {
+			SEXP p = mkInteger64( 1 );
+			memcpy( REAL( p ), &e->u.integer, sizeof( e->u.integer ) );
+			return p;
+		}
+		return ScalarReal( (double)e->u.integer );
+	case ELEMENT_STRING:
+	case ELEMENT_BIGINT:
+		return ScalarString( STRING_ELT( arena->strings, e->u.index ) );
+	case ELEMENT_SEXP:
+		return VECTOR_ELT( arena->values, e->u.index );
 	}
+	return parse_options->null_as_na ? ScalarLogical( NA_LOGICAL ) : R_NilValue;
+}
+
+int hasSameDim( SEXP a, SEXP b )
+{
+	if( GET_LENGTH( a ) != GET_LENGTH( b ) )
+		return FALSE;
+	for( int i = 0; i < GET_LENGTH( a ); i++ )
+		if( INTEGER( a )[i] != INTEGER( b )[i] )
+			return FALSE;
+	return TRUE;
 }
 
-int readSequence( const char* s, int i, unsigned short* unicode )
+/* Builds a matrix (or higher dimension array) from an array of rows, when every element is an
+   atomic vector with the same type, length and dim; the rows become the first dimension.
+   Only nested JSON arrays are pushed as unnamed atomic values, so objects never qualify.
+   Returns NULL, without popping anything, when the elements do not form a matrix. */
+SEXP popMatrix( const ParseOptions* parse_options, ParseArenaMark mark )
 {
-	for( int j = 1; j <= 4; j++ )
-		if( ( ( s[i + j] >= 'a' && s[i + j] <= 'f' ) || ( s[i + j] >= 'A' && s[i + j] <= 'F' ) ||
-			  ( s[i + j] >= '0' && s[i + j] <= '9' ) ) == FALSE ) {
-			return j - 1;
+	ParseArena* arena = parse_options->arena;
+	const ParseElement* elements = arena->elements + mark.elements_top;
+	R_xlen_t n = arena->elements_top - mark.elements_top;
+	SEXPTYPE matrix_type = NILSXP;
+	SEXP first = NULL, first_dim = R_NilValue, matrix, dim;
+	R_xlen_t len = 0;
+
+	for( R_xlen_t i = 0; i < n; i++ ) {
+		if( elements[i].kind != ELEMENT_SEXP )
+			return NULL;
+		SEXP p = VECTOR_ELT( arena->values, elements[i].u.index );
+		SEXPTYPE type = TYPEOF( p );
+		if( type != LGLSXP && type != INTSXP && type != REALSXP && type != STRSXP )
+			return NULL;
+		if( GET_NAMES( p ) != R_NilValue || inherits( p, "integer64" ) )
+			return NULL;
+		if( i == 0 ) {
+			first = p;
+			first_dim = GET_DIM( p );
+			len = XLENGTH( p );
+			matrix_type = type;
+			if( len == 0 )
+				return NULL;
+			continue;
+		}
+		if( XLENGTH( p ) != len || !hasSameDim( GET_DIM( p ), first_dim ) )
+			return NULL;
+		if( type != matrix_type ) {
+			/* integer and double rows promote to double */
+			if( ( type == INTSXP || type == REALSXP ) &&
+				( matrix_type == INTSXP || matrix_type == REALSXP ) )
+				matrix_type = REALSXP;
+			else
+				return NULL;
+		}
+	}
+	if( first == NULL || n > INT_MAX || len > INT_MAX || (double)n * len > R_XLEN_T_MAX )
+		return NULL;
+
+	/* element k of row i lands at [i + n * k], which is column-major order for dim c(n, ...) */
+	PROTECT( matrix = allocVector( matrix_type, n * len ) );
+	for( R_xlen_t i = 0; i < n; i++ ) {
+		SEXP p = VECTOR_ELT( arena->values, elements[i].u.index );
+		for( R_xlen_t k = 0; k < len; k++ ) {
+			switch( matrix_type ) {
+			case LGLSXP:
+				LOGICAL( matrix )[i + n * k] = LOGICAL( p )[k];
+				break;
+			case INTSXP:
+				INTEGER( matrix )[i + n * k] = INTEGER( p )[k];
+				break;
+			case REALSXP:
+				if( TYPEOF( p ) == REALSXP )
+					REAL( matrix )[i + n * k] = REAL( p )[k];
+				else if( INTEGER( p )[k] == NA_INTEGER )
+					REAL( matrix )[i + n * k] = NA_REAL;
+				else
+					REAL( matrix )[i + n * k] = INTEGER( p )[k];
+				break;
+			case STRSXP:
+				SET_STRING_ELT( matrix, i + n * k, STRING_ELT( p, k ) );
+				break;
+			}
 		}
-	char unicode_buf[5]; /* to hold 4 digit hex (to prevent scanning a 5th digit accidentally */
-	strncpy( unicode_buf, s + i + 1, 5 );
-	unicode_buf[4] = '\0';
-	sscanf( unicode_buf, "%hx", unicode );
-	return 4;
-}
-
-/* Attempts to parse a javascript escaped UTF-16 sequence into a unicode codepoint from a buffer.
-   If the sequence is invalid no unicode value will be set. 
-   The function will return the number of read bytes as an indicator of whether input was successfully parsed */
-int parseUTF16Sequence( const char* s, int i, unsigned long* unicode )
-{
-	int read_bytes = 0;
-	unsigned short high;
-	read_bytes += readSequence( s, i, &high );
-	if( read_bytes != 4 )
-		return read_bytes;
-	/* check if this is a UTF-16 surrogate pair */
-	if( ( high >= 0xD800 && high <= 0xDBFF ) &&
-		( s[i + read_bytes + 1] == '\\' && s[i + read_bytes + 2] == 'u' ) ) {
-		read_bytes += 2;
-		i += read_bytes; /* parse the next UTF-16 sequence, we are now pointing at the next 'u' */
-		unsigned short low;
-		read_bytes += readSequence( s, i, &low );
-		if( read_bytes != 10 )
-			return read_bytes;
-		*unicode = ( (unsigned long)( high - 0xD800 ) ) * 0x400 + ( low - 0xDC00 ) +
-				   0x10000; /* Decode the surrogate pair into a unicode codepoint */
 	}
+
+	int inner_dims = first_dim == R_NilValue ? 1 : GET_LENGTH( first_dim );
+	PROTECT( dim = allocVector( INTSXP, inner_dims + 1 ) );
+	INTEGER( dim )[0] = (int)n;
+	if( first_dim == R_NilValue )
+		INTEGER( dim )[1] = (int)len;
 	else
-		*unicode = high;
+		for( int d = 0; d < inner_dims; d++ )
+			INTEGER( dim )[d + 1] = INTEGER( first_dim )[d];
+	setAttrib( matrix, R_DimSymbol, dim );
+
+	resetParseArena( arena, mark );
+	UNPROTECT( 2 );
+	return matrix;
+}
 
-	return read_bytes;
+/* sets element i of a simplified array to its type's missing value */
+void setNAElement( SEXP array, R_xlen_t i, int is_integer64 )
+{
+	long long na = NA_INTEGER64;
+	switch( TYPEOF( array ) ) {
+	case LGLSXP:
+		LOGICAL( array )[i] = NA_LOGICAL;
+		break;
+	case INTSXP:
+		INTEGER( array )[i] = NA_INTEGER;
+		break;
+	case REALSXP:
+		if( is_integer64 )
+			memcpy( REAL( array ) + i, &na, sizeof( na ) );
+		else
+			REAL( array )[i] = NA_REAL;
+		break;
+	case STRSXP:
+		SET_STRING_ELT( array, i, NA_STRING );
+		break;
+	}
 }
 
-int getUnexpectedEscapeHandlingCode( const char* s )
+/* copies the elements pushed since mark into a single vector, and pops them */
+SEXP popArray( const ParseOptions* parse_options, ParseArenaMark mark, int simplify )
 {
-	if( s != NULL ) {
-		if( strcmp( s, "skip" ) == 0 ) {
-			return UNEXPECTED_ESCAPE_SKIP;
+	ParseArena* arena = parse_options->arena;
+	SEXP array;
+	const ParseElement* elements = arena->elements + mark.elements_top;
+	R_xlen_t n = arena->elements_top - mark.elements_top;
+	SEXPTYPE array_type = VECSXP;
+	int is_integer64 = FALSE;
+	char buf[32];
+
+	if( simplify && parse_options->simplify_matrix && n > 0 ) {
+		SEXP matrix = popMatrix( parse_options, mark );
+		if( matrix != NULL )
+			return matrix;
+	}
+
+	if( simplify && n > 0 ) {
+		int seen[CLASS_NULL + 1] = {0};
+		for( R_xlen_t i = 0; i < n; i++ )
+			seen[getElementClass( arena, &elements[i] )] = TRUE;
+
+		/* with null = "NA", nulls are missing values of whichever type the other elements have,
+		   and an array of only nulls is a logical NA vector (as c( NA, NA ) is in R) */
+		int has_number = seen[CLASS_INT32] || seen[CLASS_INT53] || seen[CLASS_INT64] ||
+						 seen[CLASS_REAL];
+		int n_types = seen[CLASS_LOGICAL] + seen[CLASS_STRING] + has_number;
+		if( seen[CLASS_LIST] || ( seen[CLASS_NULL] && !parse_options->null_as_na ) || n_types > 1 )
+			array_type = VECSXP;
+		else if( n_types == 0 || seen[CLASS_LOGICAL] )
+			array_type = LGLSXP;
+		else if( seen[CLASS_STRING] )
+			array_type = STRSXP;
+		else
+			array_type = getNumberType( parse_options,
+										seen[CLASS_REAL],
+										seen[CLASS_INT64]
+											? CLASS_INT64
+											: ( seen[CLASS_INT53] ? CLASS_INT53 : CLASS_INT32 ),
+										&is_integer64 );
+	}
+
+	PROTECT( array = is_integer64 ? mkInteger64( n ) : allocVector( array_type, n ) );
+	for( R_xlen_t i = 0; i < n; i++ ) {
+		const ParseElement* e = &elements[i];
+		SEXP p = e->kind == ELEMENT_SEXP ? VECTOR_ELT( arena->values, e->u.index ) : NULL;
+		if( e->kind == ELEMENT_NULL && array_type != VECSXP ) {
+			setNAElement( array, i, is_integer64 );
+			continue;
 		}
-		else if( strcmp( s, "keep" ) == 0 ) {
-			return UNEXPECTED_ESCAPE_KEEP;
+		switch( array_type ) {
+		case LGLSXP:
+			LOGICAL( array )[i] = p ? LOGICAL( p )[0] : e->u.logical;
+			break;
+		case INTSXP:
+			INTEGER( array )[i] = p ? INTEGER( p )[0] : (int)e->u.integer;
+			break;
+		case REALSXP:
+			if( is_integer64 ) {
+				long long value = getElementInteger64( arena, e );
+				memcpy( REAL( array ) + i, &value, sizeof( value ) );
+			}
+			else {
+				REAL( array )[i] = getElementDouble( arena, e );
+			}
+			break;
+		case STRSXP:
+			if( p ) {
+				SET_STRING_ELT( array, i, STRING_ELT( p, 0 ) );
+			}
+			else if( e->kind == ELEMENT_INTEGER ) {
+				snprintf( buf, sizeof( buf ), "%lld", e->u.integer );
+				SET_STRING_ELT( array, i, mkChar( buf ) );
+			}
+			else {
+				SET_STRING_ELT( array, i, STRING_ELT( arena->strings, e->u.index ) );
+			}
+			break;
+		default:
+			SET_VECTOR_ELT( array, i, boxElement( parse_options, e ) );
 		}
 	}
-	/* in all other cases, just use the standard original error */
-	return UNEXPECTED_ESCAPE_ERROR;
+	resetParseArena( arena, mark );
+	UNPROTECT( 1 ); /* array */
+	return array;
+}
+
+/* hashes a UTF-8 key (FNV-1a) */
+unsigned int hashKey( const char* key )
+{
+	unsigned int h = 2166136261u;
+	for( ; *key; key++ )
+		h = ( h ^ (unsigned char)*key ) * 16777619u;
+	return h;
+}
+
+/* returns the slot of an open addressed table of 1 based positions in names which holds key, or the
+   empty slot where it belongs; size is a power of two */
+R_xlen_t findHashedKey( SEXP names, const int* table, R_xlen_t size, const char* key )
+{
+	R_xlen_t j = hashKey( key ) & ( size - 1 );
+	while( table[j] != 0 && strcmp( CHAR( STRING_ELT( names, table[j] - 1 ) ), key ) != 0 )
+		j = ( j + 1 ) & ( size - 1 );
+	return j;
+}
+
+/* copies the key/value pairs pushed since mark into a named list of class rjson_hashed, and pops
+   them. Its index attribute holds the names and a table of their positions, which hashedGet() uses
+   to look keys up without scanning the names; as with assignment, a repeated key keeps its last
+   value (at the position of its first) */
+SEXP popHashedList( const ParseOptions* parse_options, ParseArenaMark mark )
+{
+	ParseArena* arena = parse_options->arena;
+	SEXP list, list_names, slots, index, key;
+	PROTECT_INDEX list_pi, names_pi;
+	const ParseElement* elements = arena->elements + mark.elements_top;
+	R_xlen_t n = ( arena->elements_top - mark.elements_top ) / 2, k = 0, size = 2, j;
+	int* table;
+
+	while( size < 2 * n )
+		size *= 2;
+	PROTECT_WITH_INDEX( list = allocVector( VECSXP, n ), &list_pi );
+	PROTECT_WITH_INDEX( list_names = allocVector( STRSXP, n ), &names_pi );
+	PROTECT( slots = allocVector( INTSXP, size ) );
+	table = INTEGER( slots );
+	memset( table, 0, size * sizeof( int ) );
+	for( R_xlen_t i = 0; i < n; i++ ) {
+		key = STRING_ELT( arena->strings, elements[2 * i].u.index );
+		j = findHashedKey( list_names, table, size, CHAR( key ) );
+		if( table[j] == 0 ) {
+			SET_STRING_ELT( list_names, k, key );
+			table[j] = (int)++k;
+		}
+		SET_VECTOR_ELT( list, table[j] - 1, boxElement( parse_options, &elements[2 * i + 1] ) );
+	}
+	if( k < n ) {
+		REPROTECT( list = xlengthgets( list, k ), list_pi );
+		REPROTECT( list_names = xlengthgets( list_names, k ), names_pi );
+	}
+	setAttrib( list, R_NamesSymbol, list_names );
+
+	/* the names are kept so that hashedGet() can tell whether they were changed since */
+	PROTECT( index = allocVector( VECSXP, 2 ) );
+	SET_VECTOR_ELT( index, 0, getAttrib( list, R_NamesSymbol ) );
+	SET_VECTOR_ELT( index, 1, slots );
+	setAttrib( list, install( "index" ), index );
+	SET_CLASS( list, mkString( HASHED_CLASS ) );
+	resetParseArena( arena, mark );
+	UNPROTECT( 4 );
+	return list;
 }
 
-SEXP fromJSON( SEXP str_in, SEXP unexpected_escape_behavior, SEXP simplify )
+/* looks a key up in a list built by popHashedList(), returning NULL when it is missing; once the
+   names of the list have been changed, they are scanned instead */
+SEXP hashedGet( SEXP x, SEXP key )
+{
+	SEXP names = getAttrib( x, R_NamesSymbol );
+	SEXP index = getAttrib( x, install( "index" ) );
+	const char* s;
+	R_xlen_t j;
+
+	if( !isString( key ) || XLENGTH( key ) != 1 || STRING_ELT( key, 0 ) == NA_STRING )
+		Rf_error( "the key must be a single string" );
+	s = translateCharUTF8( STRING_ELT( key, 0 ) );
+	if( TYPEOF( x ) != VECSXP || names == R_NilValue )
+		return R_NilValue;
+
+	if( TYPEOF( index ) == VECSXP && XLENGTH( index ) == 2 && VECTOR_ELT( index, 0 ) == names &&
+		TYPEOF( VECTOR_ELT( index, 1 ) ) == INTSXP ) {
+		const int* table = INTEGER( VECTOR_ELT( index, 1 ) );
+		j = findHashedKey( names, table, XLENGTH( VECTOR_ELT( index, 1 ) ), s );
+		return table[j] == 0 ? R_NilValue : VECTOR_ELT( x, table[j] - 1 );
+	}
+	for( j = 0; j < XLENGTH( names ); j++ )
+		if( strcmp( translateCharUTF8( STRING_ELT( names, j ) ), s ) == 0 )
+			return VECTOR_ELT( x, j );
+	return R_NilValue;
+}
+
+/* copies the key/value pairs pushed since mark into a named list, and pops them */
+SEXP popList( const ParseOptions* parse_options, ParseArenaMark mark )
+{
+	ParseArena* arena = parse_options->arena;
+	SEXP list, list_names;
+	const ParseElement* elements = arena->elements + mark.elements_top;
+	R_xlen_t n = ( arena->elements_top - mark.elements_top ) / 2;
+
+	/* positions in the index are stored as ints */
+	if( parse_options->hash_threshold > 0 && n >= parse_options->hash_threshold && n <= INT_MAX / 2 )
+		return popHashedList( parse_options, mark );
+
+	PROTECT( list = allocVector( VECSXP, n ) );
+	PROTECT( list_names = allocVector( STRSXP, n ) );
+	for( R_xlen_t i = 0; i < n; i++ ) {
+		SET_STRING_ELT( list_names, i, STRING_ELT( arena->strings, elements[2 * i].u.index ) );
+		SET_VECTOR_ELT( list, i, boxElement( parse_options, &elements[2 * i + 1] ) );
+	}
+	setAttrib( list, R_NamesSymbol, list_names );
+	resetParseArena( arena, mark );
+	UNPROTECT( 2 );
+	return list;
+}
+
+SEXP getListElement( SEXP list, const char* name )
+{
+	SEXP names = GET_NAMES( list );
+	for( int i = 0; i < GET_LENGTH( list ); i++ )
+		if( strcmp( CHAR( STRING_ELT( names, i ) ), name ) == 0 )
+			return VECTOR_ELT( list, i );
+	Rf_error( "missing parse option %s\n", name );
+}
+
+/* reads the list of options built by .parseOptions() in json.R */
+void readParseOptions( SEXP options, ParseOptions* parse_options )
+{
+	parse_options->unexpected_escape_behavior = getUnexpectedEscapeHandlingCode(
+		CHAR( STRING_ELT( getListElement( options, "unexpected.escape" ), 0 ) ) );
+	parse_options->invalid_utf8_behavior = getInvalidUTF8HandlingCode(
+		CHAR( STRING_ELT( getListElement( options, "invalid.utf8" ), 0 ) ) );
+	parse_options->simplify_lists = asLogical( getListElement( options, "simplify" ) );
+	parse_options->simplify_matrix = asLogical( getListElement( options, "matrix" ) ) == TRUE;
+	parse_options->integer = asLogical( getListElement( options, "integer" ) ) == TRUE;
+	/* .parseOptions() has already rejected NA and negative values, but converting a double which is
+	   out of range is undefined, so infinite and huge values are clamped here as well */
+	double hash_threshold = asReal( getListElement( options, "hash.threshold" ) );
+	if( !R_FINITE( hash_threshold ) || hash_threshold <= 0 )
+		parse_options->hash_threshold = 0;
+	else if( hash_threshold >= R_XLEN_T_MAX )
+		parse_options->hash_threshold = R_XLEN_T_MAX;
+	else
+		parse_options->hash_threshold = (R_xlen_t)ceil( hash_threshold );
+	parse_options->null_as_na =
+		strcmp( CHAR( STRING_ELT( getListElement( options, "null" ), 0 ) ), "NA" ) == 0;
+
+	const char* bigint = CHAR( STRING_ELT( getListElement( options, "bigint" ), 0 ) );
+	if( strcmp( bigint, "integer64" ) == 0 )
+		parse_options->bigint = BIGINT_INTEGER64;
+	else if( strcmp( bigint, "string" ) == 0 )
+		parse_options->bigint = BIGINT_STRING;
+	else
+		parse_options->bigint = BIGINT_DOUBLE;
+}
+
+/* the core's string options, which unescape into the arena scratch buffer */
+void getStringOptions( const ParseOptions* parse_options, JSONStringOptions* options )
+{
+	options->unexpected_escape_behavior = parse_options->unexpected_escape_behavior;
+	options->invalid_utf8_behavior = parse_options->invalid_utf8_behavior;
+	options->reserve = reserveArenaScratch;
+	options->warn = warnUnexpectedEscape;
+	options->ctx = parse_options->arena;
+	options->cancelled = NULL;
+}
+
+SEXP fromJSON( SEXP str_in, SEXP options, SEXP schema )
 {
 	const char* s = CHAR( STRING_ELT( str_in, 0 ) );
 	const char* next_ch = s;
 	SEXP p, next_i, list;
+	ParseArena arena;
 
 	ParseOptions parse_options;
-	parse_options.unexpected_escape_behavior =
-		getUnexpectedEscapeHandlingCode( CHAR( STRING_ELT( unexpected_escape_behavior, 0 ) ) );
-	parse_options.simplify_lists = LOGICAL( simplify )[0];
+	readParseOptions( options, &parse_options );
+	parse_options.arena = &arena;
+
+	const JSONSchema* json_schema = schema == R_NilValue ? NULL : getJSONSchema( schema );
+
+	initParseArena( &arena );
+
+	if( json_schema )
+		PROTECT( p = parseSchemaValue( s, &next_ch, json_schema, &parse_options ) );
+	else
+		PROTECT( p = parseValue( s, &next_ch, &parse_options ) );
 
-	PROTECT( p = parseValue( s, &next_ch, &parse_options ) );
+	/* trailing whitespace counts as parsed */
+	while( *next_ch == ' ' || *next_ch == '\t' || *next_ch == '\n' || *next_ch == '\r' )
+		next_ch++;
 
 	PROTECT( list = allocVector( VECSXP, 2 ) );
 	PROTECT( next_i = allocVector( INTSXP, 1 ) );
@@ -218,7 +781,7 @@ SEXP fromJSON( SEXP str_in, SEXP unexpected_escape_behavior, SEXP simplify )
 	INTEGER( next_i )[0] = next_ch - s;
 	SET_VECTOR_ELT( list, 1, next_i );
 
-	UNPROTECT( 3 );
+	UNPROTECT( 3 + PARSE_ARENA_PROTECT_COUNT );
 	return list;
 }
 
@@ -257,326 +820,163 @@ SEXP parseValue( const char* s, const char** next_ch, const ParseOptions* parse_
 	return mkError( "unexpected character '%c'\n", *s );
 }
 
-SEXP parseNull( const char* s, const char** next_ch, const ParseOptions* parse_options )
+/* Parses a value and pushes it onto the arena rather than returning it; scalars are stored
+   unboxed. Returns NULL on success, or the error. */
+SEXP parseElement( const char* s, const char** next_ch, const ParseOptions* parse_options )
 {
-	if( strncmp( s, "null", 4 ) == 0 ) {
-		*next_ch = s + 4;
-		return R_NilValue;
-	}
+	ParseArena* arena = parse_options->arena;
+	SEXP p;
+	ParseElement number;
 
-	/* TODO should really look at subset of "null" (e.g. "nul", "nu" ), so that "not" fails before reaching 4 digits */
-	if( strlen( s ) < 4 ) {
-		return mkErrorWithClass( INCOMPLETE_CLASS,
-								 "parseNull: expected to see 'null' - likely an unquoted string "
-								 "starting with 'n', or truncated null.\n" );
-	}
-	return mkError(
-		"parseNull: expected to see 'null' - likely an unquoted string starting with 'n'.\n" );
-}
+	/* ignore whitespace */
+	while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+		s++;
 
-SEXP parseTrue( const char* s, const char** next_ch, const ParseOptions* parse_options )
-{
-	SEXP p;
-	if( strncmp( s, "true", 4 ) == 0 ) {
-		*next_ch = s + 4;
-		PROTECT( p = NEW_LOGICAL( 1 ) );
-		LOGICAL( p )[0] = TRUE;
-		UNPROTECT( 1 );
-		return p;
+	if( *s == '\"' ) {
+		p = parseStringChar( s, next_ch, parse_options );
+		if( TYPEOF( p ) != CHARSXP )
+			return p;
+		pushStringElement( arena, p );
+		return NULL;
 	}
-	if( strlen( s ) < 4 ) {
-		return mkErrorWithClass( INCOMPLETE_CLASS,
-								 "parseTrue: expected to see 'true' - likely an unquoted string "
-								 "starting with 't', or truncated true.\n" );
+	if( ( *s >= '0' && *s <= '9' ) || *s == '-' ) {
+		if( ( p = scanNumberElement( s, next_ch, parse_options, &number ) ) != NULL )
+			return p;
+		if( number.kind == ELEMENT_BIGINT )
+			pushBigIntElement( arena, s, *next_ch );
+		else
+			*pushElement( arena, number.kind ) = number;
+		return NULL;
 	}
-	return mkError(
-		"parseTrue: expected to see 'true' - likely an unquoted string starting with 't'.\n" );
-}
-
-SEXP parseFalse( const char* s, const char** next_ch, const ParseOptions* parse_options )
-{
-	SEXP p;
-	if( strncmp( s, "false", 5 ) == 0 ) {
-		*next_ch = s + 5;
-		PROTECT( p = NEW_LOGICAL( 1 ) );
-		LOGICAL( p )[0] = FALSE;
-		UNPROTECT( 1 );
-		return p;
+	if( *s == 't' || *s == 'f' ) {
+		if( ( p = ( *s == 't' ? scanTrue( s, next_ch ) : scanFalse( s, next_ch ) ) ) != NULL )
+			return p;
+		pushElement( arena, ELEMENT_LOGICAL )->u.logical = *s == 't';
+		return NULL;
 	}
-	if( strlen( s ) < 5 ) {
-		return mkErrorWithClass( INCOMPLETE_CLASS,
-								 "parseFalse: expected to see 'false' - likely an unquoted string "
-								 "starting with 'f', or truncated false.\n" );
+	if( *s == 'n' ) {
+		if( ( p = scanNull( s, next_ch ) ) != NULL )
+			return p;
+		pushElement( arena, ELEMENT_NULL );
+		return NULL;
 	}
-	return mkError(
-		"parseFalse: expected to see 'false' - likely an unquoted string starting with 'f'.\n" );
+
+	p = parseValue( s, next_ch, parse_options );
+	if( hasClass( p, TRYERROR_CLASS ) == TRUE )
+		return p;
+	pushSEXPElement( arena, p );
+	return NULL;
 }
 
-SEXP parseString( const char* s, const char** next_ch, const ParseOptions* parse_options )
+SEXP scanNull( const char* s, const char** next_ch )
 {
-	SEXP p, error_p;
-	/* assert( s[ 0 ] == '"' ); */
-	int i = 1; /* skip the start quote */
-
-	int buf_size = 256;
-	char* buf = (char*)malloc( buf_size );
-	buf[0] = '\0';
-	int buf_i = 0;
-	if( buf == NULL ) {
-		error_p = mkError( "error allocating memory in parseString" );
-		goto error;
-	}
-	if( sizeof( char ) != 1 ) {
-		error_p = mkError( "parseString sizeof(char) != 1" );
-		goto error;
-	}
+	JSONError err;
+	return scanJSONNull( s, next_ch, &err ) == JSON_OK ? NULL : mkCoreError( &err );
+}
 
-	int copy_start = i;
-	int bytes_to_copy;
+SEXP scanTrue( const char* s, const char** next_ch )
+{
+	JSONError err;
+	return scanJSONTrue( s, next_ch, &err ) == JSON_OK ? NULL : mkCoreError( &err );
+}
 
-	while( 1 ) {
-		while( s[i] != '\\' && s[i] != '"' && s[i] != '\0' )
-			i++;
-		if( s[i] == '\0' ) {
-			error_p = mkErrorWithClass( INCOMPLETE_CLASS, "unclosed string\n" );
-			goto error;
-		}
+SEXP scanFalse( const char* s, const char** next_ch )
+{
+	JSONError err;
+	return scanJSONFalse( s, next_ch, &err ) == JSON_OK ? NULL : mkCoreError( &err );
+}
 
-		if( s[i] == '\\' ) {
-			if( s[i + 1] == '\0' ) {
-				error_p = mkErrorWithClass( INCOMPLETE_CLASS, "unclosed string\n" );
-				goto error;
-			}
-			/* TODO couldn't this be caught above (where s[ i ] == '\0') */
-			if( s[i + 2] == '\0' ) {
-				error_p = mkErrorWithClass( INCOMPLETE_CLASS, "unclosed string\n" );
-				goto error;
-			}
+SEXP parseNull( const char* s, const char** next_ch, const ParseOptions* parse_options )
+{
+	SEXP err = scanNull( s, next_ch );
+	if( err )
+		return err;
+	return parse_options->null_as_na ? ScalarLogical( NA_LOGICAL ) : R_NilValue;
+}
 
-			/* grow memory */
-			if( buf_size - 1 <= i ) {
-				buf_size = 2 * ( buf_size + i );
-				buf = realloc( buf, buf_size );
-				if( buf == NULL ) {
-					error_p = mkError( "error allocating memory in parseString" );
-					goto error;
-				}
-			}
+SEXP parseTrue( const char* s, const char** next_ch, const ParseOptions* parse_options )
+{
+	SEXP err = scanTrue( s, next_ch );
+	return err ? err : ScalarLogical( TRUE );
+}
 
-			/* save string chunk from copy_start to i-1 */
-			bytes_to_copy = i - copy_start;
-			if( bytes_to_copy > 0 ) {
+SEXP parseFalse( const char* s, const char** next_ch, const ParseOptions* parse_options )
+{
+	SEXP err = scanFalse( s, next_ch );
+	return err ? err : ScalarLogical( FALSE );
+}
 
-				memcpy( buf + buf_i, s + copy_start, bytes_to_copy );
-				buf_i += bytes_to_copy;
-			}
-			i++;
-
-			/* save s[i] */
-			switch( s[i] ) {
-			case '"':
-			case '\\':
-			case '/':
-				buf[buf_i] = s[i];
-				break;
-			case 'b':
-				buf[buf_i] = '\b';
-				break;
-			case 'f':
-				buf[buf_i] = '\f';
-				break;
-			case 'n':
-				buf[buf_i] = '\n';
-				break;
-			case 'r':
-				buf[buf_i] = '\r';
-				break;
-			case 't':
-				buf[buf_i] = '\t';
-				break;
-			case 'u': ; /* semi-colon required to prevent windows-compile warning related to var declaration inside case statement */
-				unsigned long unicode;
-				int read_bytes = parseUTF16Sequence( s, i, &unicode );
-				if( read_bytes != 4 && read_bytes != 10 ) {
-					/* In case of surrogate pairs read_bytes will be 10 */
-					error_p = mkError( "unexpected unicode escaped char '%c'; 4 hex digits should "
-									   "follow the \\u (found %i valid digits)",
-									   s[i + read_bytes + 1],
-									   read_bytes );
-					goto error;
-				}
-				i +=
-					read_bytes; /* skip the UTF16 sequence(s) - actually point to last digit, which is then incremented outside of switch */
-				buf_i += UTF8EncodeUnicode( unicode, buf + buf_i ) -
-						 1; /* -1 due to buf_i++ out of loop */
-				break;
-			default:
-				if( parse_options->unexpected_escape_behavior == UNEXPECTED_ESCAPE_SKIP ) {
-					/* skip the character (by decreasing the buffer index as it will be increased below. in actuality we dont want it to change). */
-					buf_i--;
-					Rf_warning(
-						"unexpected escaped character '\\%c' at pos %i. Skipping value.", s[i], i );
-				}
-				else if( parse_options->unexpected_escape_behavior == UNEXPECTED_ESCAPE_KEEP ) {
-					/* treat a "\y" as simply 'y' */
-					buf[buf_i] = s[i];
-					Rf_warning(
-						"unexpected escaped character '\\%c' at pos %i. Keeping value.", s[i], i );
-				}
-				else {
-					/* case of UNEXPECTED_ESCAPE_ERROR, or any other bad enum values */
-					error_p = mkError( "unexpected escaped character '\\%c' at pos %i", s[i], i );
-					goto error;
-				}
-				break;
-			}
+SEXP parseString( const char* s, const char** next_ch, const ParseOptions* parse_options )
+{
+	SEXP p = parseStringChar( s, next_ch, parse_options );
+	if( TYPEOF( p ) != CHARSXP )
+		return p;
+	return ScalarString( p );
+}
 
-			i++; /* move to next char */
-			copy_start = i;
-			buf_i++;
-		}
-		else {
-			/* must be a quote that caused us the exit the loop, first, save remaining string data */
-			if( buf_size - 1 <= i ) {
-				/* grow memory */
-				buf_size = 2 * ( buf_size + i );
-				buf = realloc( buf, buf_size );
-				if( buf == NULL ) {
-					error_p = mkError( "error allocating memory in parseString" );
-					goto error;
-				}
-			}
-			bytes_to_copy = i - copy_start;
-			if( bytes_to_copy > 0 ) {
-				memcpy( buf + buf_i, s + copy_start, bytes_to_copy );
-				buf_i += bytes_to_copy;
-			}
-			buf[buf_i] = '\0';
-			break; /* exit the loop */
-		}
-	}
+/* Unescapes a string and returns it as a CHARSXP (or an error) */
+SEXP parseStringChar( const char* s, const char** next_ch, const ParseOptions* parse_options )
+{
+	size_t len;
+	SEXP err = unescapeString( s, next_ch, parse_options, &len );
+	if( err != NULL )
+		return err;
+	return mkCharCE( parse_options->arena->scratch, CE_UTF8 );
+}
 
-	*next_ch = s + i + 1;
-	PROTECT( p = allocVector( STRSXP, 1 ) );
-	SET_STRING_ELT( p, 0, mkCharCE( buf, CE_UTF8 ) );
-	free( buf );
-	UNPROTECT( 1 );
-	return p;
-error:
-	if( buf ) {
-		free( buf );
-	}
-	return error_p;
-}
-
-void setArrayElement( SEXP array, int unsigned i, SEXP val )
-{
-	if( IS_LOGICAL( array ) )
-		LOGICAL( array )[i] = LOGICAL( val )[0];
-	else if( IS_INTEGER( array ) )
-		INTEGER( array )[i] = INTEGER( val )[0];
-	else if( IS_NUMERIC( array ) )
-		REAL( array )[i] = REAL( val )[0];
-	else if( IS_CHARACTER( array ) )
-		SET_STRING_ELT(
-			array, i, STRING_ELT( val, 0 ) ); /* TODO fixme val must be a single char, not vector */
-	/*	else if( IS_COMPLEX( array ) )
-		COMPLEX( array [ i ] = COMPLEX( val )[ 0 ]; */
-	else
-		Rprintf( "unsupported SEXPTYPE: %i\n", TYPEOF( array ) );
+/* Unescapes a string into the arena scratch buffer (which is '\0' terminated, and len bytes long).
+   Returns NULL on success, or the error. */
+SEXP unescapeString( const char* s,
+					 const char** next_ch,
+					 const ParseOptions* parse_options,
+					 size_t* len )
+{
+	JSONStringOptions options;
+	JSONError err;
+	getStringOptions( parse_options, &options );
+	if( unescapeJSONString( s, next_ch, &options, len, &err ) != JSON_OK )
+		return mkCoreError( &err );
+	return NULL;
 }
 
 SEXP parseArray( const char* s, const char** next_ch, const ParseOptions* parse_options )
 {
-	PROTECT_INDEX array_index = -1;
-	SEXP p = NULL, array = NULL;
+	ParseArena* arena = parse_options->arena;
+	ParseArenaMark mark = markParseArena( arena );
+	SEXP err;
 	/* assert( *s == '[' ) */
 	s++; /* move past '[' */
-	int is_list = FALSE;
-	SEXPTYPE p_type = -1;
-	unsigned int array_i = 0;
 
 	int trailing_comma = 0;
 
-	PROTECT_WITH_INDEX( array = R_NilValue, &array_index );
-
 	while( 1 ) {
 		/* ignore whitespace */
 		while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
 			s++;
 		if( *s == '\0' ) {
-			UNPROTECT( 1 ); /* array */
 			return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete array\n" );
 		}
 
 		if( *s == ']' ) {
 			if( trailing_comma ) {
-				UNPROTECT( 1 ); /* array */
 				return mkErrorWithClass( INCOMPLETE_CLASS, "trailing comma found in array\n" );
 			}
 
 			*next_ch = s + 1;
-			UNPROTECT( 1 ); /* array */
 			return allocVector( VECSXP, 0 );
 		}
 		trailing_comma = 0;
 
-		PROTECT( p = parseValue( s, next_ch, parse_options ) );
+		err = parseElement( s, next_ch, parse_options );
+		if( err != NULL )
+			return err;
 		s = *next_ch;
 
-		/* check p for errors */
-		if( hasClass( p, TRYERROR_CLASS ) == TRUE ) {
-			UNPROTECT( 2 ); /* p, array */
-			return p;
-		}
-
-		if( array == R_NilValue ) {
-			if( !parse_options->simplify_lists ) {
-				p_type = VECSXP;
-				is_list = TRUE;
-			}
-			else if( GET_LENGTH( p ) != 1 ) {
-				p_type = VECSXP;
-				is_list = TRUE;
-			}
-			else if( TYPEOF( p ) == VECSXP ) {
-				p_type = VECSXP;
-				is_list = TRUE;
-			}
-			else {
-				p_type = TYPEOF( p );
-				is_list = FALSE;
-			}
-			REPROTECT( array = allocVector( p_type, DEFAULT_VECTOR_START_SIZE ), array_index );
-		}
-
-		/* check array type matches */
-		if( is_list == FALSE && ( TYPEOF( p ) != TYPEOF( array ) || GET_LENGTH( p ) != 1 ) ) {
-			REPROTECT( array = coerceVector( array, VECSXP ), array_index );
-			is_list = TRUE;
-		}
-
-		/* checksize */
-		unsigned int array_size = GET_LENGTH( array );
-		if( array_i >= array_size ) {
-			REPROTECT( SET_LENGTH( array, array_size * 2 ), array_index );
-		}
-
-		/* save element */
-		if( is_list == TRUE )
-			SET_VECTOR_ELT( array, array_i, p );
-		else
-			setArrayElement( array, array_i, p );
-		UNPROTECT( 1 ); /* p */
-		p = NULL;
-		array_i++;
-
 		/* ignore whitespace */
 		while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
 			s++;
 
 		if( *s == '\0' ) {
-			UNPROTECT( 1 ); /* array */
 			return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete array\n" );
 		}
 
@@ -590,49 +990,33 @@ SEXP parseArray( const char* s, const char** next_ch, const ParseOptions* parse_
 			s++;
 			trailing_comma = 1;
 		}
-		else if( *s == '\0' ) {
-			UNPROTECT( 1 ); /* array */
-			return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete array\n" );
-		}
 		else {
-			UNPROTECT( 1 ); /* array */
 			return mkError( "unexpected character: %c\n", *s );
 		}
 	}
 
-	/* trim to the correct size - no need to protect here */
-	SET_LENGTH( array, array_i );
-
 	*next_ch = s + 1;
 
-	UNPROTECT( 1 ); /* array */
-
-	return array;
+	return popArray( parse_options, mark, parse_options->simplify_lists );
 }
 
 SEXP parseList( const char* s, const char** next_ch, const ParseOptions* parse_options )
 {
-	PROTECT_INDEX list_index, list_names_index;
-	SEXP key = NULL, val = NULL, list, list_names;
+	ParseArena* arena = parse_options->arena;
+	ParseArenaMark mark = markParseArena( arena );
+	SEXP key, err;
 	/* assert( *s == '{' ) */
 	s++; /* move past '{' */
-	unsigned int list_i = 0;
-
-	PROTECT_WITH_INDEX( list = allocVector( VECSXP, DEFAULT_VECTOR_START_SIZE ), &list_index );
-	PROTECT_WITH_INDEX( list_names = allocVector( STRSXP, DEFAULT_VECTOR_START_SIZE ),
-						&list_names_index );
 
 	while( 1 ) {
 		/* ignore whitespace */
 		while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
 			s++;
 		if( *s == '\0' ) {
-			UNPROTECT( 2 );
 			return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete list\n" );
 		}
 
-		if( *s == '}' && list_i == 0 ) {
-			UNPROTECT( 2 );
+		if( *s == '}' && arena->elements_top == mark.elements_top ) {
 			*next_ch = s + 1;
 			return allocVector( VECSXP, 0 );
 		}
@@ -640,31 +1024,22 @@ SEXP parseList( const char* s, const char** next_ch, const ParseOptions* parse_o
 		/* get key */
 
 		if( *s != '\"' ) {
-			UNPROTECT( 2 );
 			return mkError(
 				"unexpected character \"%c\"; expecting opening string quote (\") for key value\n",
 				*s );
 		}
 
-		PROTECT( key = parseString( s, next_ch, parse_options ) );
-		s = *next_ch;
-
-		/* check key for errors */
-		if( hasClass( key, TRYERROR_CLASS ) == TRUE ) {
-			UNPROTECT( 3 );
+		key = parseStringChar( s, next_ch, parse_options );
+		if( TYPEOF( key ) != CHARSXP ) {
 			return key;
 		}
-
-		if( IS_CHARACTER( key ) == FALSE ) {
-			UNPROTECT( 3 );
-			return mkError( "list keys must be strings\n" );
-		}
+		pushStringElement( arena, key );
+		s = *next_ch;
 
 		/* ignore whitespace */
 		while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
 			s++;
 		if( *s != ':' ) {
-			UNPROTECT( 3 );
 			if( *s == '\0' )
 				return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete list - missing :\n" );
 			return mkError( "incomplete list - missing :\n" );
@@ -675,40 +1050,19 @@ SEXP parseList( const char* s, const char** next_ch, const ParseOptions* parse_o
 		while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
 			s++;
 		if( *s == '\0' ) {
-			UNPROTECT( 3 );
 			return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete list\n" );
 		}
 
 		/* get value */
-		PROTECT( val = parseValue( s, next_ch, parse_options ) );
+		err = parseElement( s, next_ch, parse_options );
+		if( err != NULL )
+			return err;
 		s = *next_ch;
 
-		/* check val for errors */
-		if( hasClass( val, TRYERROR_CLASS ) == TRUE ) {
-			UNPROTECT( 4 );
-			return val;
-		}
-
-		/* checksize */
-		unsigned int list_size = GET_LENGTH( list );
-		if( list_i >= list_size ) {
-			REPROTECT( SET_LENGTH( list, list_size * 2 ), list_index );
-			REPROTECT( SET_LENGTH( list_names, list_size * 2 ), list_names_index );
-		}
-
-		/* save key and value */
-		SET_STRING_ELT( list_names, list_i, STRING_ELT( key, 0 ) );
-		SET_VECTOR_ELT( list, list_i, val );
-		UNPROTECT( 2 ); /* key, val */
-		key = NULL;
-		val = NULL;
-		list_i++;
-
 		/* ignore whitespace */
 		while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
 			s++;
 		if( *s == '\0' ) {
-			UNPROTECT( 2 );
 			return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete list\n" );
 		}
 
@@ -722,93 +1076,70 @@ SEXP parseList( const char* s, const char** next_ch, const ParseOptions* parse_o
 			s++;
 		}
 		else {
-			UNPROTECT( 2 );
 			return mkError( "unexpected character: %c\n", *s );
 		}
 	}
 
-	/* trim to the correct size */
-	REPROTECT( SET_LENGTH( list, list_i ), list_index );
-	REPROTECT( SET_LENGTH( list_names, list_i ), list_names_index );
-
-	/* set names */
-	setAttrib( list, R_NamesSymbol, list_names );
-
 	*next_ch = s + 1;
 
-	UNPROTECT( 2 );
-	return list;
+	return popList( parse_options, mark );
 }
 
 SEXP parseNumber( const char* s, const char** next_ch, const ParseOptions* parse_options )
 {
-	SEXP p;
-	const char* start = s;
-	char buf[MAX_NUMBER_BUF];
-	int digits_before_period = 0;
-	int exponent_digits = 0;
-
-	if( *s == '-' ) {
-		s++;
-	}
-
-	if( *s == '\0' ) {
-		return mkErrorWithClass( INCOMPLETE_CLASS, "parseNumer error\n" );
-	}
-
-	if( *s == '0' ) {
-		digits_before_period++;
-		s++;
-		if( ( *s >= '0' && *s <= '9' ) || *s == 'x' ) {
-			return mkError( "hex or octal is not valid json\n" );
-		}
-	}
-
-	while( *s >= '0' && *s <= '9' ) {
-		digits_before_period++;
-		s++;
-	}
-
-	if( *s == '.' ) {
-		if( digits_before_period == 0 ) {
-			return mkError( "numbers must start with a digit\n" );
-		}
-		s++;
-		while( *s >= '0' && *s <= '9' ) {
-			s++;
-		}
-	}
+	ParseElement e;
+	SEXP err = scanNumberElement( s, next_ch, parse_options, &e );
+	if( err == NULL && e.kind == ELEMENT_BIGINT )
+		return ScalarString( mkCharLenCE( s, (int)( *next_ch - s ), CE_UTF8 ) );
+	return err ? err : boxElement( parse_options, &e );
+}
 
-	/* exponential */
-	if( *s == 'e' || *s == 'E' ) {
-		s++;
-		if( *s == '+' || *s == '-' ) {
-			s++;
-		}
-		while( *s >= '0' && *s <= '9' ) {
-			s++;
-			exponent_digits++;
+/* Reads a number into an element. Integral numbers are kept as exact 64 bit integers when integer
+   or bigint output was requested, so that the container can choose their type once it is closed. */
+SEXP scanNumberElement( const char* s,
+						const char** next_ch,
+						const ParseOptions* parse_options,
+						ParseElement* e )
+{
+	SEXP err = scanNumber( s, next_ch, &e->u.number );
+	if( err != NULL )
+		return err;
+	e->kind = ELEMENT_NUMBER;
+
+	long long value;
+	int integral;
+	if( parse_options->integer || parse_options->bigint != BIGINT_DOUBLE ) {
+		integral = scanJSONInteger( s, *next_ch, &value );
+		if( integral == 1 && value != NA_INTEGER64 ) {
+			e->kind = ELEMENT_INTEGER;
+			e->u.integer = value;
 		}
-		if( exponent_digits == 0 ) {
-			return mkError( "missing exponent\n" );
+		/* beyond 64 bits (or NA_integer64_ itself) only the digits are exact; the caller keeps them */
+		else if( integral != 0 && parse_options->bigint == BIGINT_STRING ) {
+			e->kind = ELEMENT_BIGINT;
 		}
 	}
+	return NULL;
+}
 
-	unsigned int len = s - start;
-	if( len >= MAX_NUMBER_BUF ) {
-		return mkError( "buffer issue parsing number: increase MAX_NUMBER_BUF (in parser.c) "
-						"current value is %i\n",
-						MAX_NUMBER_BUF );
-	}
-
-	/* copy to buf, which is used with atof */
-	strncpy( buf, start, len );
-	buf[len] = '\0';
+/* Reads a number without allocating an R value. Returns NULL on success, or the error. */
+SEXP scanNumber( const char* s, const char** next_ch, double* value )
+{
+	JSONError err;
+	return scanJSONNumber( s, next_ch, value, &err ) == JSON_OK ? NULL : mkCoreError( &err );
+}
 
-	*next_ch = s;
+/* Validates the syntax of a number, and sets next_ch to the character following it */
+SEXP skipNumber( const char* s, const char** next_ch )
+{
+	JSONError err;
+	return skipJSONNumber( s, next_ch, &err ) == JSON_OK ? NULL : mkCoreError( &err );
+}
 
-	PROTECT( p = allocVector( REALSXP, 1 ) );
-	REAL( p )[0] = atof( buf );
-	UNPROTECT( 1 );
-	return p;
+/* Validates a value and sets next_ch past it without creating any R objects (unless there is an
+   error to return). The contents of escape sequences inside skipped strings are not checked. */
+SEXP skipValue( const char* s, const char** next_ch )
+{
+	JSONError err;
+	return skipJSONValue( s, next_ch, &err ) == JSON_OK ? NULL : mkCoreError( &err );
 }
@@ -0,0 +1,190 @@
+#ifndef RJSON_PARSER_H
+#define RJSON_PARSER_H
+
+/* internal interface shared by the C parsing code; the .Call entry points are in funcs.h */
+
+#include "jsoncore.h"
+
+#define ELEMENT_NULL 0
+#define ELEMENT_LOGICAL 1
+#define ELEMENT_NUMBER 2
+#define ELEMENT_STRING 3 /* CHARSXP stored in ParseArena.strings */
+#define ELEMENT_SEXP 4 /* nested container stored in ParseArena.values */
+#define ELEMENT_INTEGER 5 /* integral number, only used when integer or bigint output is requested */
+#define ELEMENT_BIGINT 6 /* integral number beyond 64 bits, as its digits in ParseArena.strings (bigint = "string") */
+
+/* a parsed array element (or object key/value) which has not yet been copied into its container */
+typedef struct ParseElement
+{
+	int kind;
+	union
+	{
+		int logical;
+		double number;
+		long long integer;
+		R_xlen_t index; /* position in ParseArena.strings or ParseArena.values */
+	} u;
+} ParseElement;
+
+/* Scratch memory shared by every parse function during a single fromJSON call.
+   C memory comes from R_alloc, so it is all released at once when the .Call returns (even if an R
+   error unwinds it); the two R stacks are protected by the caller for the duration of the call.
+   Containers push their elements onto the stacks while parsing, and copy them into an exactly
+   sized R vector once the closing bracket is seen. */
+typedef struct ParseArena
+{
+	char* scratch; /* string unescaping buffer */
+	size_t scratch_size;
+
+	ParseElement* elements;
+	R_xlen_t elements_size;
+	R_xlen_t elements_top;
+
+	SEXP strings; /* STRSXP */
+	PROTECT_INDEX strings_index;
+	R_xlen_t strings_top;
+
+	SEXP values; /* VECSXP */
+	PROTECT_INDEX values_index;
+	R_xlen_t values_top;
+} ParseArena;
+
+/* stack positions to restore once a container has been built */
+typedef struct ParseArenaMark
+{
+	R_xlen_t elements_top;
+	R_xlen_t strings_top;
+	R_xlen_t values_top;
+} ParseArenaMark;
+
+/* number of entries initParseArena pushes onto the protect stack */
+#define PARSE_ARENA_PROTECT_COUNT 2
+
+#define BIGINT_DOUBLE 0 /* integers beyond 2^53 lose precision as doubles */
+#define BIGINT_INTEGER64 1 /* exact, as bit64 compatible integer64 vectors */
+#define BIGINT_STRING 2 /* exact, as decimal strings */
+#define NA_INTEGER64 LLONG_MIN /* as used by the bit64 package */
+
+typedef struct ParseOptions
+{
+	int unexpected_escape_behavior;
+	int invalid_utf8_behavior; /* for bytes in strings which are not UTF-8 */
+	int simplify_lists;
+	int simplify_matrix; /* build matrices and arrays from equally sized nested arrays */
+	int integer; /* use integer vectors when every number fits */
+	int bigint;
+	R_xlen_t hash_threshold; /* objects with at least this many keys become hashed lists; 0 for never */
+	int null_as_na; /* read null as NA (of the array's type) rather than NULL */
+	ParseArena* arena;
+} ParseOptions;
+
+SEXP parseValue( const char* s, const char** next_ch, const ParseOptions* parse_options );
+SEXP parseNull( const char* s, const char** next_ch, const ParseOptions* parse_options );
+SEXP parseTrue( const char* s, const char** next_ch, const ParseOptions* parse_options );
+SEXP parseFalse( const char* s, const char** next_ch, const ParseOptions* parse_options );
+SEXP parseString( const char* s, const char** next_ch, const ParseOptions* parse_options );
+SEXP parseNumber( const char* s, const char** next_ch, const ParseOptions* parse_options );
+SEXP parseArray( const char* s, const char** next_ch, const ParseOptions* parse_options );
+SEXP parseList( const char* s, const char** next_ch, const ParseOptions* parse_options );
+
+SEXP parseElement( const char* s, const char** next_ch, const ParseOptions* parse_options );
+SEXP parseStringChar( const char* s, const char** next_ch, const ParseOptions* parse_options );
+SEXP skipValue( const char* s, const char** next_ch );
+SEXP scanNumber( const char* s, const char** next_ch, double* value );
+SEXP scanNumberElement( const char* s,
+						const char** next_ch,
+						const ParseOptions* parse_options,
+						ParseElement* e );
+SEXP skipNumber( const char* s, const char** next_ch );
+SEXP scanNull( const char* s, const char** next_ch );
+SEXP scanTrue( const char* s, const char** next_ch );
+SEXP scanFalse( const char* s, const char** next_ch );
+
+#define TRYERROR_CLASS "try-error"
+#define INCOMPLETE_CLASS "incomplete"
+#define HASHED_CLASS "rjson_hashed"
+
+SEXP mkError( const char* format, ... );
+SEXP mkErrorWithClass( const char* class, const char* format, ... );
+int hasClass( SEXP p, const char* class );
+
+int getUnexpectedEscapeHandlingCode( const char* s );
+int getInvalidUTF8HandlingCode( const char* s );
+void readParseOptions( SEXP options, ParseOptions* parse_options );
+void getStringOptions( const ParseOptions* parse_options, JSONStringOptions* options );
+SEXP mkCoreError( const JSONError* err );
+
+void initParseArena( ParseArena* arena );
+char* reserveScratch( ParseArena* arena, size_t size );
+ParseElement* pushElement( ParseArena* arena, int kind );
+void pushStringElement( ParseArena* arena, SEXP ch );
+void pushBigIntElement( ParseArena* arena, const char* s, const char* end );
+void pushSEXPElement( ParseArena* arena, SEXP p );
+ParseArenaMark markParseArena( const ParseArena* arena );
+void resetParseArena( ParseArena* arena, ParseArenaMark mark );
+SEXP boxElement( const ParseOptions* parse_options, const ParseElement* e );
+void setNAElement( SEXP array, R_xlen_t i, int is_integer64 );
+SEXP popArray( const ParseOptions* parse_options, ParseArenaMark mark, int simplify );
+SEXP popList( const ParseOptions* parse_options, ParseArenaMark mark );
+
+SEXP unescapeString( const char* s,
+					 const char** next_ch,
+					 const ParseOptions* parse_options,
+					 size_t* len );
+
+/* buffered input, see reader.c */
+#define READ_CHUNK_SIZE 65536
+
+/* Buffers a stream of JSON text read from a file descriptor, a (possibly compressed) file, or
+   appended from R. The buffer is always NUL terminated so the parser can read it in place. */
+typedef struct JSONReader
+{
+	int fd; /* -1 when not reading from a file descriptor */
+	int owns_fd; /* opened from a path, and closed with the reader */
+	FILE* pipe; /* the output of a command, whose fd is read */
+	void* gz; /* gzFile, for files read by fillJSONReaderFile */
+	void* zstd; /* ZSTD_DStream, when zstd support is compiled in */
+	FILE* zstd_file;
+	char* zstd_in;
+	size_t zstd_in_pos, zstd_in_len;
+	size_t zstd_ret; /* last ZSTD_decompressStream result; non-zero while a frame is unfinished */
+	int eof;
+	char* buf;
+	size_t start; /* first unconsumed byte */
+	size_t len; /* end of the buffered data */
+	size_t size;
+	/* how far scanJSONFrame has got through the document at start (see reader.c) */
+	size_t frame_scanned;
+	int frame_depth;
+	int frame_state;
+} JSONReader;
+
+JSONReader* allocJSONReader( void );
+SEXP wrapJSONReader( JSONReader* reader );
+void freeJSONReader( JSONReader* reader );
+void closeJSONReader( SEXP ptr );
+int growJSONReader( JSONReader* reader, size_t n );
+void reserveReader( JSONReader* reader, size_t n );
+void openJSONReaderFile( JSONReader* reader, const char* path );
+int readJSONReaderFile( JSONReader* reader, size_t* n, JSONError* err );
+size_t fillJSONReaderFile( JSONReader* reader );
+
+/* compiled schemas, see schema.c */
+typedef struct JSONSchema JSONSchema;
+
+const JSONSchema* getJSONSchema( SEXP ptr );
+SEXP parseSchemaValue( const char* s,
+					   const char** next_ch,
+					   const JSONSchema* schema,
+					   const ParseOptions* parse_options );
+SEXP parseSchemaRecord( const char* s,
+						const char** next_ch,
+						const JSONSchema* schema,
+						const ParseOptions* parse_options );
+
+/* documents and records, see vector.c */
+SEXP parseDocument( const char* s, const JSONSchema* json_schema, const ParseOptions* parse_options );
+int isRecord( SEXP p, const char* s );
+SEXP recordsToDataFrame( SEXP rows );
+
+#endif
@@ -0,0 +1,480 @@
+#include <R.h>
+#include <Rdefines.h>
+#include <errno.h>
+#include <string.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "funcs.h"
+#include "parser.h"
+
+#define READER_TAG "rjson_reader"
+/* stop reading and hand the frames to R once a single call has read this much */
+#define MAX_READ_PER_CALL ( 16 * 1024 * 1024 )
+/* longest wait between checks for a user interrupt */
+#define POLL_INTERVAL_MS 100
+
+
+/* releases a reader, its buffer and its input */
+void freeJSONReader( JSONReader* reader )
+{
+#ifndef _WIN32
+	if( reader->owns_fd )
+		close( reader->fd );
+	if( reader->pipe )
+		pclose( reader->pipe );
+#endif
+	if( reader->gz )
+		gzclose( (gzFile)reader->gz );
+#ifdef HAVE_ZSTD
+	if( reader->zstd ) {
+		ZSTD_freeDStream( (ZSTD_DStream*)reader->zstd );
+		fclose( reader->zstd_file );
+		free( reader->zstd_in );
+	}
+#endif
+	free( reader->buf );
+	free( reader );
+}
+
+void readerFinalizer( SEXP ptr )
+{
+	JSONReader* reader = (JSONReader*)R_ExternalPtrAddr( ptr );
+	if( reader == NULL )
+		return;
+	freeJSONReader( reader );
+	R_ClearExternalPtr( ptr );
+}
+
+/* releases the reader's buffer and input now, rather than when it is garbage collected */
+void closeJSONReader( SEXP ptr )
+{
+	readerFinalizer( ptr );
+}
+
+JSONReader* allocJSONReader( void )
+{
+	JSONReader* reader = (JSONReader*)calloc( 1, sizeof( JSONReader ) );
+	if( reader == NULL )
+		Rf_error( "unable to allocate JSON reader\n" );
+	reader->fd = -1;
+	reader->size = READ_CHUNK_SIZE;
+	reader->buf = (char*)malloc( reader->size + 1 );
+	if( reader->buf == NULL ) {
+		free( reader );
+		Rf_error( "unable to allocate JSON reader\n" );
+	}
+	reader->buf[0] = '\0';
+	return reader;
+}
+
+SEXP wrapJSONReader( JSONReader* reader )
+{
+	SEXP ptr;
+	PROTECT( ptr = R_MakeExternalPtr( reader, install( READER_TAG ), R_NilValue ) );
+	R_RegisterCFinalizerEx( ptr, readerFinalizer, TRUE );
+	UNPROTECT( 1 );
+	return ptr;
+}
+
+/* input is either a file descriptor (-1 for data appended from R), the path of a file (or named
+   pipe) to open, or, when command is TRUE, a shell command whose output is read */
+SEXP newJSONReader( SEXP input, SEXP command )
+{
+	SEXP ptr;
+	JSONReader* reader = allocJSONReader();
+	PROTECT( ptr = wrapJSONReader( reader ) );
+
+#ifdef _WIN32
+	if( TYPEOF( input ) == STRSXP || asInteger( input ) >= 0 )
+		Rf_error( "reading from a file descriptor is not supported on Windows; use a connection\n" );
+#else
+	if( TYPEOF( input ) == STRSXP && asLogical( command ) == TRUE ) {
+		const char* cmd = translateChar( STRING_ELT( input, 0 ) );
+		reader->pipe = popen( cmd, "r" );
+		if( reader->pipe == NULL )
+			Rf_error( "unable to run %s: %s\n", cmd, strerror( errno ) );
+		reader->fd = fileno( reader->pipe );
+	}
+	else if( TYPEOF( input ) == STRSXP ) {
+		const char* path = translateChar( STRING_ELT( input, 0 ) );
+		reader->fd = open( path, O_RDONLY );
+		if( reader->fd < 0 )
+			Rf_error( "unable to open %s: %s\n", path, strerror( errno ) );
+		reader->owns_fd = TRUE;
+	}
+	else {
+		reader->fd = asInteger( input );
+	}
+#endif
+
+	UNPROTECT( 1 );
+	return ptr;
+}
+
+JSONReader* getJSONReader( SEXP ptr )
+{
+	if( TYPEOF( ptr ) != EXTPTRSXP || R_ExternalPtrTag( ptr ) != install( READER_TAG ) )
+		Rf_error( "reader must be created by newJSONReader\n" );
+	if( R_ExternalPtrAddr( ptr ) == NULL )
+		Rf_error( "reader is no longer valid; call newJSONReader again\n" );
+	return (JSONReader*)R_ExternalPtrAddr( ptr );
+}
+
+/* makes room for at least n more bytes after the buffered data; returns FALSE if out of memory */
+int growJSONReader( JSONReader* reader, size_t n )
+{
+	/* drop consumed bytes first, which is usually enough */
+	if( reader->start > 0 ) {
+		memmove( reader->buf, reader->buf + reader->start, reader->len - reader->start + 1 );
+		reader->len -= reader->start;
+		reader->start = 0;
+	}
+	if( reader->len + n > reader->size ) {
+		size_t new_size = 2 * reader->size;
+		if( new_size < reader->len + n )
+			new_size = reader->len + n;
+		char* buf = (char*)realloc( reader->buf, new_size + 1 );
+		if( buf == NULL )
+			return FALSE;
+		reader->buf = buf;
+		reader->size = new_size;
+	}
+	return TRUE;
+}
+
+void reserveReader( JSONReader* reader, size_t n )
+{
+	if( !growJSONReader( reader, n ) )
+		Rf_error( "unable to grow JSON reader buffer to %lu bytes\n", (unsigned long)( reader->len + n ) );
+}
+
+SEXP appendJSONReader( SEXP ptr, SEXP data )
+{
+	JSONReader* reader = getJSONReader( ptr );
+	if( TYPEOF( data ) != RAWSXP )
+		Rf_error( "data must be a raw vector\n" );
+	if( XLENGTH( data ) == 0 ) {
+		reader->eof = TRUE;
+		return R_NilValue;
+	}
+	reserveReader( reader, XLENGTH( data ) );
+	memcpy( reader->buf + reader->len, RAW( data ), XLENGTH( data ) );
+	reader->len += XLENGTH( data );
+	reader->buf[reader->len] = '\0';
+	return R_NilValue;
+}
+
+#ifndef _WIN32
+/* Waits up to timeout_ms (forever if negative) for the fd to become readable, then reads
+   everything which is available without blocking again. Returns the number of bytes read. */
+size_t fillJSONReader( JSONReader* reader, int timeout_ms )
+{
+	struct pollfd pfd;
+	size_t total = 0;
+	int wait = timeout_ms;
+
+	pfd.fd = reader->fd;
+	pfd.events = POLLIN;
+	while( !reader->eof && total < MAX_READ_PER_CALL ) {
+		int slice = wait < 0 || wait > POLL_INTERVAL_MS ? POLL_INTERVAL_MS : wait;
+		int ready = poll( &pfd, 1, slice );
+		if( ready < 0 ) {
+			if( errno == EINTR )
+				continue;
+			Rf_error( "poll failed: %s\n", strerror( errno ) );
+		}
+		if( ready == 0 ) {
+			if( wait >= 0 && ( wait -= slice ) <= 0 )
+				break;
+			R_CheckUserInterrupt();
+			continue;
+		}
+
+		reserveReader( reader, READ_CHUNK_SIZE );
+		ssize_t n = read( reader->fd, reader->buf + reader->len, READ_CHUNK_SIZE );
+		if( n < 0 ) {
+			if( errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK )
+				continue;
+			Rf_error( "read failed: %s\n", strerror( errno ) );
+		}
+		if( n == 0 ) {
+			reader->eof = TRUE;
+			break;
+		}
+		reader->len += n;
+		reader->buf[reader->len] = '\0';
+		total += n;
+		/* only drain what is already waiting */
+		wait = 0;
+	}
+	return total;
+}
+#endif
+
+/* Opens a file for fillJSONReaderFile. zlib reads both gzip compressed and plain files; zstd
+   compressed files (by their .zst extension) need zstd support to be compiled in. */
+void openJSONReaderFile( JSONReader* reader, const char* path )
+{
+	size_t path_len = strlen( path );
+	if( path_len > 4 && strcmp( path + path_len - 4, ".zst" ) == 0 ) {
+#ifdef HAVE_ZSTD
+		reader->zstd_file = fopen( path, "rb" );
+		if( reader->zstd_file == NULL )
+			Rf_error( "unable to open %s: %s\n", path, strerror( errno ) );
+		reader->zstd_in = (char*)malloc( ZSTD_DStreamInSize() );
+		reader->zstd = ZSTD_createDStream();
+		if( reader->zstd_in == NULL || reader->zstd == NULL )
+			Rf_error( "unable to allocate zstd decompression stream\n" );
+		ZSTD_initDStream( (ZSTD_DStream*)reader->zstd );
+		return;
+#else
+		Rf_error( "%s is zstd compressed, but rjson was built without zstd support\n", path );
+#endif
+	}
+
+	reader->gz = gzopen( path, "rb" );
+	if( reader->gz == NULL )
+		Rf_error( "unable to open %s: %s\n", path, errno ? strerror( errno ) : "out of memory" );
+	gzbuffer( (gzFile)reader->gz, READ_CHUNK_SIZE );
+}
+
+#ifdef HAVE_ZSTD
+/* returns the number of bytes decompressed, or -1 with err set */
+ptrdiff_t readZstdChunk( JSONReader* reader, char* out, size_t size, JSONError* err )
+{
+	ZSTD_outBuffer output = { out, size, 0 };
+	while( output.pos == 0 ) {
+		if( reader->zstd_in_pos == reader->zstd_in_len ) {
+			reader->zstd_in_len = fread( reader->zstd_in, 1, ZSTD_DStreamInSize(), reader->zstd_file );
+			reader->zstd_in_pos = 0;
+			if( reader->zstd_in_len == 0 && ferror( reader->zstd_file ) )
+				return -setJSONError( err, JSON_ERROR, "read failed: %s\n", strerror( errno ) );
+		}
+		/* the end of the file, after a complete frame */
+		if( reader->zstd_in_len == 0 && reader->zstd_ret == 0 )
+			return 0;
+
+		ZSTD_inBuffer input = { reader->zstd_in, reader->zstd_in_len, reader->zstd_in_pos };
+		reader->zstd_ret = ZSTD_decompressStream( (ZSTD_DStream*)reader->zstd, &output, &input );
+		if( ZSTD_isError( reader->zstd_ret ) )
+			return -setJSONError( err,
+								  JSON_ERROR,
+								  "zstd decompression failed: %s\n",
+								  ZSTD_getErrorName( reader->zstd_ret ) );
+		reader->zstd_in_pos = input.pos;
+
+		if( reader->zstd_in_len == 0 && output.pos == 0 )
+			return -setJSONError( err, JSON_ERROR, "truncated zstd input\n" );
+	}
+	return output.pos;
+}
+#endif
+
+/* Decompresses the next chunk of a file opened by openJSONReaderFile onto the end of the
+   buffer, and sets *n to the number of bytes added, which is 0 (with eof set) at the end of the
+   file. Returns JSON_OK, or JSON_ERROR with err set. The R API is not used, so this can also run
+   on a worker thread (see async.c). */
+int readJSONReaderFile( JSONReader* reader, size_t* n, JSONError* err )
+{
+	ptrdiff_t ret;
+	*n = 0;
+	if( reader->eof )
+		return JSON_OK;
+	if( !growJSONReader( reader, READ_CHUNK_SIZE ) )
+		return setJSONError( err, JSON_ERROR, "unable to grow JSON reader buffer\n" );
+#ifdef HAVE_ZSTD
+	if( reader->zstd ) {
+		if( ( ret = readZstdChunk( reader, reader->buf + reader->len, READ_CHUNK_SIZE, err ) ) < 0 )
+			return err->code;
+	}
+	else
+#endif
+	{
+		int errnum;
+		ret = gzread( (gzFile)reader->gz, reader->buf + reader->len, READ_CHUNK_SIZE );
+		if( ret < 0 )
+			return setJSONError(
+				err, JSON_ERROR, "decompression failed: %s\n", gzerror( (gzFile)reader->gz, &errnum ) );
+	}
+	if( ret == 0 )
+		reader->eof = TRUE;
+	reader->len += ret;
+	reader->buf[reader->len] = '\0';
+	*n = ret;
+	return JSON_OK;
+}
+
+size_t fillJSONReaderFile( JSONReader* reader )
+{
+	size_t n;
+	JSONError err;
+	if( readJSONReaderFile( reader, &n, &err ) != JSON_OK )
+		Rf_error( "%s", err.message );
+	return n;
+}
+
+int isWhitespace( char c )
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/* states of scanJSONFrame */
+#define FRAME_VALUE 0
+#define FRAME_STRING 1
+#define FRAME_STRING_ESCAPE 2
+#define FRAME_SCALAR 3
+
+int isScalarChar( char c )
+{
+	return ( c >= '0' && c <= '9' ) || ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || c == '-' ||
+		   c == '+' || c == '.';
+}
+
+/* resets the frame scan for the next document, and returns the length of the one found */
+size_t endJSONFrame( JSONReader* reader, size_t len )
+{
+	reader->frame_scanned = 0;
+	reader->frame_depth = 0;
+	reader->frame_state = FRAME_VALUE;
+	return len;
+}
+
+/* Finds the end of the document at the front of the buffer (which starts with a non-whitespace
+   character), resuming where the last call stopped, so that a document arriving in many small
+   reads is scanned only once. Only strings and brackets are followed; the document is validated
+   when it is parsed. Returns its length, or 0 if it is not complete yet. */
+size_t scanJSONFrame( JSONReader* reader )
+{
+	const char* s = reader->buf + reader->start;
+	size_t len = reader->len - reader->start;
+
+	for( size_t i = reader->frame_scanned; i < len; i++ ) {
+		char c = s[i];
+		switch( reader->frame_state ) {
+		case FRAME_STRING_ESCAPE:
+			reader->frame_state = FRAME_STRING;
+			break;
+		case FRAME_STRING:
+			if( c == '\\' )
+				reader->frame_state = FRAME_STRING_ESCAPE;
+			else if( c == '"' ) {
+				reader->frame_state = FRAME_VALUE;
+				if( reader->frame_depth == 0 )
+					return endJSONFrame( reader, i + 1 );
+			}
+			break;
+		case FRAME_SCALAR:
+			/* a number or literal ends at the first character which can not continue it */
+			if( !isScalarChar( c ) )
+				return endJSONFrame( reader, i );
+			break;
+		default:
+			if( c == '"' )
+				reader->frame_state = FRAME_STRING;
+			else if( c == '[' || c == '{' )
+				reader->frame_depth++;
+			else if( c == ']' || c == '}' ) {
+				if( --reader->frame_depth <= 0 )
+					return endJSONFrame( reader, i + 1 );
+			}
+			else if( reader->frame_depth == 0 ) {
+				if( !isScalarChar( c ) )
+					return endJSONFrame( reader, i + 1 );
+				reader->frame_state = FRAME_SCALAR;
+			}
+		}
+	}
+	/* a number at the end of the data may still be missing digits */
+	if( reader->frame_state == FRAME_SCALAR && reader->eof )
+		return endJSONFrame( reader, len );
+	reader->frame_scanned = len;
+	return 0;
+}
+
+/* Parses every complete document at the front of the buffer. A document which fails to parse is
+   returned as its try-error, and reading continues after it; one which is still unfinished when
+   the input ends is returned as an error along with the rest of the buffer. */
+SEXP parseJSONFrames( JSONReader* reader, const ParseOptions* parse_options )
+{
+	SEXP frames, p;
+	PROTECT_INDEX frames_index;
+	R_xlen_t n = 0;
+	ParseArenaMark mark = markParseArena( parse_options->arena );
+
+	PROTECT_WITH_INDEX( frames = allocVector( VECSXP, 16 ), &frames_index );
+	while( 1 ) {
+		const char* s = reader->buf + reader->start;
+		const char* next_ch = s;
+		if( reader->frame_scanned == 0 ) {
+			while( isWhitespace( *s ) )
+				s++;
+			reader->start = s - reader->buf;
+		}
+		if( *s == '\0' )
+			break;
+
+		size_t frame_len = scanJSONFrame( reader );
+		if( frame_len == 0 && !reader->eof )
+			break;
+
+		PROTECT( p = parseValue( s, &next_ch, parse_options ) );
+		resetParseArena( parse_options->arena, mark );
+		if( frame_len == 0 )
+			reader->start = reader->len;
+		else if( hasClass( p, TRYERROR_CLASS ) || next_ch > s + frame_len )
+			reader->start += frame_len;
+		else
+			reader->start = next_ch - reader->buf;
+		endJSONFrame( reader, 0 );
+
+		if( n == XLENGTH( frames ) )
+			REPROTECT( frames = xlengthgets( frames, 2 * n ), frames_index );
+		SET_VECTOR_ELT( frames, n++, p );
+		UNPROTECT( 1 ); /* p */
+	}
+	REPROTECT( frames = xlengthgets( frames, n ), frames_index );
+	UNPROTECT( 1 );
+	return frames;
+}
+
+/* Returns a list of the complete documents available, reading from the reader's fd first.
+   Waits for at least one document (up to timeout milliseconds, if not negative) when none are
+   buffered. Returns NULL once the input has ended and every document has been returned. */
+SEXP readJSONFrames( SEXP ptr, SEXP options, SEXP timeout )
+{
+	JSONReader* reader = getJSONReader( ptr );
+	int timeout_ms = asInteger( timeout );
+	SEXP frames;
+	ParseArena arena;
+
+	ParseOptions parse_options;
+	readParseOptions( options, &parse_options );
+	parse_options.arena = &arena;
+
+	initParseArena( &arena );
+
+	PROTECT( frames = parseJSONFrames( reader, &parse_options ) );
+#ifndef _WIN32
+	while( reader->fd >= 0 && XLENGTH( frames ) == 0 && !reader->eof ) {
+		size_t n = fillJSONReader( reader, timeout_ms );
+		UNPROTECT( 1 );
+		PROTECT( frames = parseJSONFrames( reader, &parse_options ) );
+		if( n == 0 || timeout_ms >= 0 )
+			break;
+	}
+#endif
+	if( XLENGTH( frames ) == 0 && reader->eof ) {
+		UNPROTECT( 1 + PARSE_ARENA_PROTECT_COUNT );
+		return R_NilValue;
+	}
+	UNPROTECT( 1 + PARSE_ARENA_PROTECT_COUNT );
+	return frames;
+}
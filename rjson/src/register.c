@@ -6,7 +6,35 @@
 #include "funcs.h"
 
 static const R_CMethodDef cMethods[] = {
-	{"fromJSON", (DL_FUNC)&fromJSON, 3}, {"toJSON", (DL_FUNC)&toJSON, 1}, {NULL, NULL, 0}};
+	{"fromJSON", (DL_FUNC)&fromJSON, 3},
+	{"fromJSONVector", (DL_FUNC)&fromJSONVector, 5},
+	{"fromJSONFile", (DL_FUNC)&fromJSONFile, 3},
+	{"fromNDJSON", (DL_FUNC)&fromNDJSON, 5},
+	{"toJSON", (DL_FUNC)&toJSON, 3},
+	{"compileJSONSchema", (DL_FUNC)&compileJSONSchema, 1},
+	{"newJSONWriter", (DL_FUNC)&newJSONWriter, 1},
+	{"writeJSONBegin", (DL_FUNC)&writeJSONBegin, 2},
+	{"writeJSONEnd", (DL_FUNC)&writeJSONEnd, 2},
+	{"writeJSONKey", (DL_FUNC)&writeJSONKey, 2},
+	{"writeJSONValue", (DL_FUNC)&writeJSONValue, 2},
+	{"flushJSONWriter", (DL_FUNC)&flushJSONWriter, 2},
+	{"closeJSONWriter", (DL_FUNC)&closeJSONWriter, 2},
+	{"newJSONReader", (DL_FUNC)&newJSONReader, 2},
+	{"appendJSONReader", (DL_FUNC)&appendJSONReader, 2},
+	{"readJSONFrames", (DL_FUNC)&readJSONFrames, 3},
+	{"parseJSONLazy", (DL_FUNC)&parseJSONLazy, 2},
+	{"lazyGet", (DL_FUNC)&lazyGet, 2},
+	{"lazyLength", (DL_FUNC)&lazyLength, 1},
+	{"lazyNames", (DL_FUNC)&lazyNames, 1},
+	{"lazyValue", (DL_FUNC)&lazyValue, 1},
+	{"lazyType", (DL_FUNC)&lazyType, 1},
+	{"fromJSONAsync", (DL_FUNC)&fromJSONAsync, 2},
+	{"asyncValue", (DL_FUNC)&asyncValue, 1},
+	{"asyncResolved", (DL_FUNC)&asyncResolved, 1},
+	{"toMsgPack", (DL_FUNC)&toMsgPack, 1},
+	{"fromMsgPack", (DL_FUNC)&fromMsgPack, 2},
+	{"hashedGet", (DL_FUNC)&hashedGet, 2},
+	{NULL, NULL, 0}};
 
 void R_init_rjson( DllInfo* info )
 {
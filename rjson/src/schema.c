@@ -0,0 +1,630 @@
+#include <R.h>
+#include <Rdefines.h>
+
+#include "funcs.h"
+#include "parser.h"
+
+#define SCHEMA_ANY 0
+#define SCHEMA_LOGICAL 1
+#define SCHEMA_INTEGER 2
+#define SCHEMA_NUMERIC 3
+#define SCHEMA_CHARACTER 4
+#define SCHEMA_POSIXCT 5
+#define SCHEMA_RAW 6 /* a base64 string, decoded into a raw vector */
+#define SCHEMA_RECORD 7
+
+#define SCHEMA_TAG "rjson_schema"
+
+typedef struct JSONSchemaField
+{
+	char* name; /* UTF-8 key */
+	size_t name_len;
+	int type;
+	int is_array;
+	struct JSONSchema* record; /* for SCHEMA_RECORD */
+} JSONSchemaField;
+
+/* a compiled record description; fields are kept in the same order as the R output list */
+struct JSONSchema
+{
+	int n_fields;
+	JSONSchemaField* fields;
+	SEXP names; /* owned by the schema list protected by the external pointer */
+};
+
+static const char* schema_type_names[] = {
+	"any", "logical", "integer", "numeric", "character", "POSIXct", "raw", "record"};
+
+/* maps a type string such as "integer" or "character[]" to a SCHEMA_ type; returns -1 if unknown */
+int getSchemaType( const char* s, int* is_array )
+{
+	size_t len = strlen( s );
+	*is_array = len > 2 && strcmp( s + len - 2, "[]" ) == 0;
+	if( *is_array )
+		len -= 2;
+
+	if( strncmp( s, "double", len ) == 0 && len == 6 )
+		return SCHEMA_NUMERIC;
+	for( int i = SCHEMA_ANY; i < SCHEMA_RECORD; i++ ) {
+		if( strlen( schema_type_names[i] ) == len && strncmp( s, schema_type_names[i], len ) == 0 )
+			return i;
+	}
+	return -1;
+}
+
+/* a list(list(...)) describes an array of records */
+int isSchemaRecordArray( SEXP x )
+{
+	return TYPEOF( x ) == VECSXP && GET_LENGTH( x ) == 1 && GET_NAMES( x ) == R_NilValue &&
+		   TYPEOF( VECTOR_ELT( x, 0 ) ) == VECSXP;
+}
+
+/* raises an R error on malformed schemas, so that compileSchemaRecord never has to */
+void validateSchemaRecord( SEXP x )
+{
+	int is_array;
+	SEXP names = GET_NAMES( x );
+	if( TYPEOF( x ) != VECSXP || names == R_NilValue )
+		Rf_error( "schema records must be named lists\n" );
+
+	for( int i = 0; i < GET_LENGTH( x ); i++ ) {
+		SEXP field = VECTOR_ELT( x, i );
+		const char* name = CHAR( STRING_ELT( names, i ) );
+		if( name[0] == '\0' )
+			Rf_error( "all schema fields must be named\n" );
+		if( isSchemaRecordArray( field ) )
+			validateSchemaRecord( VECTOR_ELT( field, 0 ) );
+		else if( TYPEOF( field ) == VECSXP )
+			validateSchemaRecord( field );
+		else if( TYPEOF( field ) != STRSXP || GET_LENGTH( field ) != 1 ||
+				 getSchemaType( CHAR( STRING_ELT( field, 0 ) ), &is_array ) < 0 )
+			Rf_error( "schema field '%s' must be a list, or one of \"any\", \"logical\", "
+					  "\"integer\", \"numeric\", \"character\", \"POSIXct\", or \"raw\" "
+					  "optionally followed by []\n",
+					  name );
+	}
+}
+
+JSONSchema* compileSchemaRecord( SEXP x )
+{
+	SEXP names = GET_NAMES( x );
+	JSONSchema* schema = (JSONSchema*)malloc( sizeof( JSONSchema ) );
+	schema->n_fields = GET_LENGTH( x );
+	schema->fields = (JSONSchemaField*)calloc( schema->n_fields, sizeof( JSONSchemaField ) );
+	schema->names = names;
+
+	for( int i = 0; i < schema->n_fields; i++ ) {
+		JSONSchemaField* field = &schema->fields[i];
+		SEXP p = VECTOR_ELT( x, i );
+
+		field->name = strdup( translateCharUTF8( STRING_ELT( names, i ) ) );
+		field->name_len = strlen( field->name );
+		if( isSchemaRecordArray( p ) ) {
+			field->type = SCHEMA_RECORD;
+			field->is_array = TRUE;
+			field->record = compileSchemaRecord( VECTOR_ELT( p, 0 ) );
+		}
+		else if( TYPEOF( p ) == VECSXP ) {
+			field->type = SCHEMA_RECORD;
+			field->record = compileSchemaRecord( p );
+		}
+		else {
+			field->type = getSchemaType( CHAR( STRING_ELT( p, 0 ) ), &field->is_array );
+		}
+	}
+	return schema;
+}
+
+void freeSchemaRecord( JSONSchema* schema )
+{
+	for( int i = 0; i < schema->n_fields; i++ ) {
+		free( schema->fields[i].name );
+		if( schema->fields[i].record )
+			freeSchemaRecord( schema->fields[i].record );
+	}
+	free( schema->fields );
+	free( schema );
+}
+
+static void schemaFinalizer( SEXP ptr )
+{
+	JSONSchema* schema = (JSONSchema*)R_ExternalPtrAddr( ptr );
+	if( schema ) {
+		freeSchemaRecord( schema );
+		R_ClearExternalPtr( ptr );
+	}
+}
+
+SEXP compileJSONSchema( SEXP schema_list )
+{
+	SEXP list, ptr, class_p;
+
+	validateSchemaRecord( schema_list );
+
+	/* keep a private copy alive, as the compiled schema refers to its names */
+	PROTECT( list = duplicate( schema_list ) );
+	PROTECT( ptr = R_MakeExternalPtr( compileSchemaRecord( list ), install( SCHEMA_TAG ), list ) );
+	R_RegisterCFinalizerEx( ptr, schemaFinalizer, TRUE );
+
+	PROTECT( class_p = allocVector( STRSXP, 1 ) );
+	SET_STRING_ELT( class_p, 0, mkChar( SCHEMA_TAG ) );
+	SET_CLASS( ptr, class_p );
+
+	UNPROTECT( 3 );
+	return ptr;
+}
+
+const JSONSchema* getJSONSchema( SEXP ptr )
+{
+	if( TYPEOF( ptr ) != EXTPTRSXP || R_ExternalPtrTag( ptr ) != install( SCHEMA_TAG ) )
+		Rf_error( "schema must be created by compileJSONSchema\n" );
+	if( R_ExternalPtrAddr( ptr ) == NULL )
+		Rf_error( "schema is no longer valid (schemas can not be saved and reloaded); "
+				  "call compileJSONSchema again\n" );
+	return (const JSONSchema*)R_ExternalPtrAddr( ptr );
+}
+
+/* Howard Hinnant's days_from_civil: days since 1970-01-01 in the proleptic Gregorian calendar */
+long daysFromCivil( long y, int m, int d )
+{
+	y -= m <= 2;
+	long era = ( y >= 0 ? y : y - 399 ) / 400;
+	long yoe = y - era * 400;
+	long doy = ( 153 * ( m + ( m > 2 ? -3 : 9 ) ) + 2 ) / 5 + d - 1;
+	long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+int readDigits( const char** s, int n, int* value )
+{
+	*value = 0;
+	for( int i = 0; i < n; i++, ( *s )++ ) {
+		if( **s < '0' || **s > '9' )
+			return FALSE;
+		*value = *value * 10 + ( **s - '0' );
+	}
+	return TRUE;
+}
+
+/* Parses "YYYY-MM-DD[(T| )HH:MM[:SS[.fff]]][Z|(+|-)HH[:]MM]" into seconds since the epoch (UTC) */
+int parseISO8601( const char* s, double* value )
+{
+	int year, month, day, hour = 0, minute = 0, second = 0, tz_hour, tz_minute;
+	double fraction = 0;
+
+	if( !readDigits( &s, 4, &year ) || *s++ != '-' || !readDigits( &s, 2, &month ) ||
+		*s++ != '-' || !readDigits( &s, 2, &day ) || month < 1 || month > 12 || day < 1 ||
+		day > 31 )
+		return FALSE;
+
+	if( *s == 'T' || *s == ' ' ) {
+		s++;
+		if( !readDigits( &s, 2, &hour ) || *s++ != ':' || !readDigits( &s, 2, &minute ) )
+			return FALSE;
+		if( *s == ':' ) {
+			s++;
+			if( !readDigits( &s, 2, &second ) )
+				return FALSE;
+			if( *s == '.' ) {
+				double scale = 0.1;
+				for( s++; *s >= '0' && *s <= '9'; s++, scale /= 10 )
+					fraction += ( *s - '0' ) * scale;
+			}
+		}
+	}
+
+	*value = ( (double)daysFromCivil( year, month, day ) * 86400.0 ) + hour * 3600 + minute * 60 +
+			 second + fraction;
+
+	if( *s == 'Z' ) {
+		s++;
+	}
+	else if( *s == '+' || *s == '-' ) {
+		int sign = *s++ == '-' ? -1 : 1;
+		if( !readDigits( &s, 2, &tz_hour ) )
+			return FALSE;
+		if( *s == ':' )
+			s++;
+		if( !readDigits( &s, 2, &tz_minute ) )
+			return FALSE;
+		*value -= sign * ( tz_hour * 3600 + tz_minute * 60 );
+	}
+	return *s == '\0';
+}
+
+SEXP mkSchemaMismatch( const JSONSchemaField* field, const char* found )
+{
+	return mkError( "schema mismatch for field '%s': expected %s%s but found %s\n",
+					field->name,
+					schema_type_names[field->type],
+					field->is_array ? "[]" : "",
+					found );
+}
+
+/* decodes a base64 string into a raw vector */
+SEXP parseSchemaRaw( const char* s,
+					 const char** next_ch,
+					 const JSONSchemaField* field,
+					 const ParseOptions* parse_options )
+{
+	SEXP p, err;
+	size_t len;
+	if( ( err = unescapeString( s, next_ch, parse_options, &len ) ) != NULL )
+		return err;
+	const char* text = parse_options->arena->scratch;
+	PROTECT( p = allocVector( RAWSXP, base64DecodedSize( text, len ) ) );
+	if( decodeBase64( text, len, RAW( p ) ) < 0 )
+		p = mkSchemaMismatch( field, "a string which is not base64" );
+	UNPROTECT( 1 );
+	return p;
+}
+
+/* pushes exactly one element of the field's type onto the arena, or returns the error */
+SEXP parseSchemaScalar( const char* s,
+						const char** next_ch,
+						const JSONSchemaField* field,
+						const ParseOptions* parse_options )
+{
+	ParseArena* arena = parse_options->arena;
+	SEXP p;
+	double number;
+	size_t len;
+
+	/* ignore whitespace */
+	while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+		s++;
+
+	if( *s == 'n' ) {
+		if( ( p = scanNull( s, next_ch ) ) != NULL )
+			return p;
+		pushElement( arena, ELEMENT_NULL );
+		return NULL;
+	}
+
+	switch( field->type ) {
+	case SCHEMA_ANY:
+		return parseElement( s, next_ch, parse_options );
+	case SCHEMA_LOGICAL:
+		if( *s != 't' && *s != 'f' )
+			return mkSchemaMismatch( field, "a non-logical value" );
+		if( ( p = ( *s == 't' ? scanTrue( s, next_ch ) : scanFalse( s, next_ch ) ) ) != NULL )
+			return p;
+		pushElement( arena, ELEMENT_LOGICAL )->u.logical = *s == 't';
+		return NULL;
+	case SCHEMA_INTEGER:
+	case SCHEMA_NUMERIC:
+		if( ( *s < '0' || *s > '9' ) && *s != '-' )
+			return mkSchemaMismatch( field, "a non-numeric value" );
+		if( ( p = scanNumber( s, next_ch, &number ) ) != NULL )
+			return p;
+		if( field->type == SCHEMA_INTEGER &&
+			( number != floor( number ) || number > INT_MAX || number <= INT_MIN ) )
+			return mkSchemaMismatch( field, "a non-integer number" );
+		pushElement( arena, ELEMENT_NUMBER )->u.number = number;
+		return NULL;
+	case SCHEMA_CHARACTER:
+		if( *s != '"' )
+			return mkSchemaMismatch( field, "a non-string value" );
+		p = parseStringChar( s, next_ch, parse_options );
+		if( TYPEOF( p ) != CHARSXP )
+			return p;
+		pushStringElement( arena, p );
+		return NULL;
+	case SCHEMA_POSIXCT:
+		if( ( *s >= '0' && *s <= '9' ) || *s == '-' ) {
+			if( ( p = scanNumber( s, next_ch, &number ) ) != NULL )
+				return p;
+		}
+		else if( *s == '"' ) {
+			if( ( p = unescapeString( s, next_ch, parse_options, &len ) ) != NULL )
+				return p;
+			if( !parseISO8601( arena->scratch, &number ) )
+				return mkSchemaMismatch( field, "a string which is not an ISO 8601 timestamp" );
+		}
+		else {
+			return mkSchemaMismatch( field, "a value which is neither a number nor a string" );
+		}
+		pushElement( arena, ELEMENT_NUMBER )->u.number = number;
+		return NULL;
+	case SCHEMA_RAW:
+		if( *s != '"' )
+			return mkSchemaMismatch( field, "a non-string value" );
+		p = parseSchemaRaw( s, next_ch, field, parse_options );
+		if( hasClass( p, TRYERROR_CLASS ) == TRUE )
+			return p;
+		pushSEXPElement( arena, p );
+		return NULL;
+	case SCHEMA_RECORD:
+		if( *s != '{' )
+			return mkSchemaMismatch( field, "a non-object value" );
+		p = parseSchemaRecord( s, next_ch, field->record, parse_options );
+		if( hasClass( p, TRYERROR_CLASS ) == TRUE )
+			return p;
+		pushSEXPElement( arena, p );
+		return NULL;
+	}
+	return mkError( "unknown schema type\n" );
+}
+
+void setPOSIXctClass( SEXP p )
+{
+	SEXP class_p;
+	PROTECT( class_p = allocVector( STRSXP, 2 ) );
+	SET_STRING_ELT( class_p, 0, mkChar( "POSIXct" ) );
+	SET_STRING_ELT( class_p, 1, mkChar( "POSIXt" ) );
+	SET_CLASS( p, class_p );
+	setAttrib( p, install( "tzone" ), mkString( "UTC" ) );
+	UNPROTECT( 1 );
+}
+
+/* copies the elements pushed since mark into a vector of the field's type (nulls become NA) */
+SEXP popSchemaElements( ParseArenaMark mark,
+						const JSONSchemaField* field,
+						const ParseOptions* parse_options )
+{
+	ParseArena* arena = parse_options->arena;
+	if( field->type == SCHEMA_ANY || field->type == SCHEMA_RECORD || field->type == SCHEMA_RAW )
+		return popArray(
+			parse_options, mark, field->type == SCHEMA_ANY && parse_options->simplify_lists );
+
+	SEXP p;
+	const ParseElement* elements = arena->elements + mark.elements_top;
+	R_xlen_t n = arena->elements_top - mark.elements_top;
+
+	switch( field->type ) {
+	case SCHEMA_LOGICAL:
+		PROTECT( p = allocVector( LGLSXP, n ) );
+		for( R_xlen_t i = 0; i < n; i++ )
+			LOGICAL( p )
+			[i] = elements[i].kind == ELEMENT_NULL ? NA_LOGICAL : elements[i].u.logical;
+		break;
+	case SCHEMA_INTEGER:
+		PROTECT( p = allocVector( INTSXP, n ) );
+		for( R_xlen_t i = 0; i < n; i++ )
+			INTEGER( p )
+			[i] = elements[i].kind == ELEMENT_NULL ? NA_INTEGER : (int)elements[i].u.number;
+		break;
+	case SCHEMA_CHARACTER:
+		PROTECT( p = allocVector( STRSXP, n ) );
+		for( R_xlen_t i = 0; i < n; i++ )
+			SET_STRING_ELT( p,
+							i,
+							elements[i].kind == ELEMENT_NULL
+								? NA_STRING
+								: STRING_ELT( arena->strings, elements[i].u.index ) );
+		break;
+	default: /* SCHEMA_NUMERIC, SCHEMA_POSIXCT */
+		PROTECT( p = allocVector( REALSXP, n ) );
+		for( R_xlen_t i = 0; i < n; i++ )
+			REAL( p )[i] = elements[i].kind == ELEMENT_NULL ? NA_REAL : elements[i].u.number;
+		if( field->type == SCHEMA_POSIXCT )
+			setPOSIXctClass( p );
+	}
+	resetParseArena( arena, mark );
+	UNPROTECT( 1 );
+	return p;
+}
+
+SEXP parseSchemaField( const char* s,
+					   const char** next_ch,
+					   const JSONSchemaField* field,
+					   const ParseOptions* parse_options )
+{
+	ParseArena* arena = parse_options->arena;
+	ParseArenaMark mark = markParseArena( arena );
+	SEXP err;
+
+	/* ignore whitespace */
+	while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+		s++;
+
+	if( !field->is_array ) {
+		if( field->type == SCHEMA_ANY )
+			return parseValue( s, next_ch, parse_options );
+		if( field->type == SCHEMA_RECORD && *s == '{' )
+			return parseSchemaRecord( s, next_ch, field->record, parse_options );
+		if( field->type == SCHEMA_RAW && *s == '"' )
+			return parseSchemaRaw( s, next_ch, field, parse_options );
+		if( ( err = parseSchemaScalar( s, next_ch, field, parse_options ) ) != NULL )
+			return err;
+		if( arena->elements[mark.elements_top].kind == ELEMENT_NULL &&
+			( field->type == SCHEMA_RECORD || field->type == SCHEMA_RAW ) ) {
+			resetParseArena( arena, mark );
+			return R_NilValue;
+		}
+		return popSchemaElements( mark, field, parse_options );
+	}
+
+	if( *s == 'n' ) {
+		if( ( err = scanNull( s, next_ch ) ) != NULL )
+			return err;
+		return R_NilValue;
+	}
+	if( *s != '[' )
+		return mkSchemaMismatch( field, "a non-array value" );
+	s++; /* move past '[' */
+
+	while( 1 ) {
+		/* ignore whitespace */
+		while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+			s++;
+		if( *s == '\0' )
+			return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete array\n" );
+		if( *s == ']' && arena->elements_top == mark.elements_top )
+			break;
+
+		if( ( err = parseSchemaScalar( s, next_ch, field, parse_options ) ) != NULL )
+			return err;
+		s = *next_ch;
+
+		/* ignore whitespace */
+		while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+			s++;
+		if( *s == ']' )
+			break;
+		if( *s == '\0' )
+			return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete array\n" );
+		if( *s != ',' )
+			return mkError( "unexpected character: %c\n", *s );
+		s++;
+	}
+	*next_ch = s + 1;
+	return popSchemaElements( mark, field, parse_options );
+}
+
+SEXP mkSchemaDefault( const JSONSchemaField* field )
+{
+	SEXP p;
+	if( field->is_array || field->type == SCHEMA_ANY || field->type == SCHEMA_RECORD ||
+		field->type == SCHEMA_RAW )
+		return R_NilValue;
+	switch( field->type ) {
+	case SCHEMA_LOGICAL:
+		return ScalarLogical( NA_LOGICAL );
+	case SCHEMA_INTEGER:
+		return ScalarInteger( NA_INTEGER );
+	case SCHEMA_CHARACTER:
+		return ScalarString( NA_STRING );
+	}
+	PROTECT( p = ScalarReal( NA_REAL ) );
+	if( field->type == SCHEMA_POSIXCT )
+		setPOSIXctClass( p );
+	UNPROTECT( 1 );
+	return p;
+}
+
+/* Parses an object directly into a list laid out by the schema. Keys are matched against the
+   field following the previous one first, so objects written in schema order never search;
+   unknown keys are skipped without creating any R objects. */
+SEXP parseSchemaRecord( const char* s,
+						const char** next_ch,
+						const JSONSchema* schema,
+						const ParseOptions* parse_options )
+{
+	ParseArena* arena = parse_options->arena;
+	SEXP record, val, err;
+	int expected = 0, first = TRUE;
+	size_t len;
+
+	/* assert( *s == '{' ) */
+	s++; /* move past '{' */
+
+	PROTECT( record = allocVector( VECSXP, schema->n_fields ) );
+	setAttrib( record, R_NamesSymbol, schema->names );
+
+	while( 1 ) {
+		/* ignore whitespace */
+		while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+			s++;
+		if( *s == '\0' ) {
+			UNPROTECT( 1 );
+			return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete list\n" );
+		}
+		if( *s == '}' && first )
+			break;
+		first = FALSE;
+
+		if( *s != '\"' ) {
+			UNPROTECT( 1 );
+			return mkError(
+				"unexpected character \"%c\"; expecting opening string quote (\") for key value\n",
+				*s );
+		}
+		if( ( err = unescapeString( s, next_ch, parse_options, &len ) ) != NULL ) {
+			UNPROTECT( 1 );
+			return err;
+		}
+		s = *next_ch;
+
+		/* find the field slot */
+		int field_i = -1;
+		if( expected < schema->n_fields && schema->fields[expected].name_len == len &&
+			memcmp( schema->fields[expected].name, arena->scratch, len ) == 0 ) {
+			field_i = expected;
+		}
+		else {
+			for( int i = 0; i < schema->n_fields; i++ ) {
+				if( schema->fields[i].name_len == len &&
+					memcmp( schema->fields[i].name, arena->scratch, len ) == 0 ) {
+					field_i = i;
+					break;
+				}
+			}
+		}
+
+		/* ignore whitespace */
+		while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+			s++;
+		if( *s != ':' ) {
+			UNPROTECT( 1 );
+			if( *s == '\0' )
+				return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete list - missing :\n" );
+			return mkError( "incomplete list - missing :\n" );
+		}
+		s++; /* move past ':' */
+
+		if( field_i < 0 ) {
+			err = skipValue( s, next_ch );
+			if( err != NULL ) {
+				UNPROTECT( 1 );
+				return err;
+			}
+		}
+		else {
+			val = parseSchemaField( s, next_ch, &schema->fields[field_i], parse_options );
+			if( hasClass( val, TRYERROR_CLASS ) == TRUE ) {
+				UNPROTECT( 1 );
+				return val;
+			}
+			SET_VECTOR_ELT( record, field_i, val );
+			expected = field_i + 1;
+		}
+		s = *next_ch;
+
+		/* ignore whitespace */
+		while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+			s++;
+		if( *s == '}' )
+			break;
+		if( *s == '\0' ) {
+			UNPROTECT( 1 );
+			return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete list\n" );
+		}
+		if( *s != ',' ) {
+			UNPROTECT( 1 );
+			return mkError( "unexpected character: %c\n", *s );
+		}
+		s++;
+	}
+	*next_ch = s + 1;
+
+	/* missing (and null) scalars become NA */
+	for( int i = 0; i < schema->n_fields; i++ ) {
+		if( VECTOR_ELT( record, i ) == R_NilValue )
+			SET_VECTOR_ELT( record, i, mkSchemaDefault( &schema->fields[i] ) );
+	}
+
+	UNPROTECT( 1 );
+	return record;
+}
+
+/* the top level value must be either a record, or an array of records */
+SEXP parseSchemaValue( const char* s,
+					   const char** next_ch,
+					   const JSONSchema* schema,
+					   const ParseOptions* parse_options )
+{
+	JSONSchemaField top;
+	top.name = (char*)"<top level>";
+	top.type = SCHEMA_RECORD;
+	top.record = (JSONSchema*)schema;
+
+	/* ignore whitespace */
+	while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+		s++;
+
+	if( *s == '\0' )
+		return mkErrorWithClass( INCOMPLETE_CLASS, "no data to parse\n" );
+	top.is_array = *s == '[';
+	return parseSchemaField( s, next_ch, &top, parse_options );
+}
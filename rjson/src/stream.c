@@ -0,0 +1,292 @@
+#include <R.h>
+#include <Rdefines.h>
+
+#include "funcs.h"
+#include "parser.h"
+
+/* Parsing of (possibly compressed) files, which are decompressed in fixed size chunks into a
+   JSONReader buffer. The elements of a top level array or object are parsed one at a time as
+   soon as they are complete, and dropped from the buffer, so the buffer only ever needs to hold
+   the largest single element rather than the whole decompressed document. */
+
+int isNumberStart( char c )
+{
+	return ( c >= '0' && c <= '9' ) || c == '-';
+}
+
+/* skips whitespace, reading more of the file as needed; returns the next character, which is
+   '\0' at the end of the file */
+char peekJSONReader( JSONReader* reader )
+{
+	while( 1 ) {
+		const char* s = reader->buf + reader->start;
+		while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+			s++;
+		reader->start = s - reader->buf;
+		if( *s != '\0' || reader->eof )
+			return *s;
+		fillJSONReaderFile( reader );
+	}
+}
+
+/* Reads until the value at the front of the buffer is complete. Returns NULL, or the error
+   found while scanning the value. */
+SEXP frameJSONReader( JSONReader* reader )
+{
+	const char* next_ch;
+	SEXP err;
+	while( 1 ) {
+		const char* s = reader->buf + reader->start;
+		err = skipValue( s, &next_ch );
+		if( err == NULL && !( *next_ch == '\0' && !reader->eof && isNumberStart( *s ) ) )
+			return NULL;
+		if( err != NULL && ( reader->eof || !hasClass( err, INCOMPLETE_CLASS ) ) )
+			return err;
+
+		/* at least double the pending data before scanning again, so that a large value is
+		   scanned a bounded number of times */
+		size_t pending = reader->len - reader->start;
+		while( !reader->eof && reader->len - reader->start < 2 * pending )
+			fillJSONReaderFile( reader );
+	}
+}
+
+/* parses the value at the front of the buffer onto the arena, once it is complete */
+SEXP streamElement( JSONReader* reader,
+					const JSONSchema* json_schema,
+					const ParseOptions* parse_options )
+{
+	const char* next_ch;
+	SEXP err;
+	if( ( err = frameJSONReader( reader ) ) != NULL )
+		return err;
+	if( json_schema ) {
+		SEXP p = parseSchemaValue( reader->buf + reader->start, &next_ch, json_schema, parse_options );
+		if( hasClass( p, TRYERROR_CLASS ) )
+			return p;
+		pushSEXPElement( parse_options->arena, p );
+	}
+	else if( ( err = parseElement( reader->buf + reader->start, &next_ch, parse_options ) ) !=
+			 NULL ) {
+		return err;
+	}
+	reader->start = next_ch - reader->buf;
+	return NULL;
+}
+
+/* expects a ',' or the closing bracket after an element; sets *done on the closing bracket */
+SEXP streamSeparator( JSONReader* reader, char closer, int* done )
+{
+	char c = peekJSONReader( reader );
+	if( c == '\0' )
+		return mkErrorWithClass(
+			INCOMPLETE_CLASS, "incomplete %s\n", closer == ']' ? "array" : "list" );
+	if( c != ',' && c != closer )
+		return mkError( "unexpected character: %c\n", c );
+	reader->start++;
+	*done = c == closer;
+	return NULL;
+}
+
+/* parses a top level array, element by element */
+SEXP streamArray( JSONReader* reader, const JSONSchema* json_schema, const ParseOptions* parse_options )
+{
+	ParseArenaMark mark = markParseArena( parse_options->arena );
+	SEXP err;
+	int done = FALSE;
+
+	reader->start++; /* move past '[' */
+	if( peekJSONReader( reader ) == ']' ) {
+		reader->start++;
+		return allocVector( VECSXP, 0 );
+	}
+	while( !done ) {
+		if( ( err = streamElement( reader, json_schema, parse_options ) ) != NULL )
+			return err;
+		if( ( err = streamSeparator( reader, ']', &done ) ) != NULL )
+			return err;
+	}
+	/* records parsed by a schema are kept as a list, as in parseSchemaValue */
+	return popArray( parse_options, mark, json_schema == NULL && parse_options->simplify_lists );
+}
+
+/* parses a top level object, key by key */
+SEXP streamList( JSONReader* reader, const ParseOptions* parse_options )
+{
+	ParseArena* arena = parse_options->arena;
+	ParseArenaMark mark = markParseArena( arena );
+	const char* next_ch;
+	SEXP key, err;
+	int done = FALSE;
+
+	reader->start++; /* move past '{' */
+	if( peekJSONReader( reader ) == '}' ) {
+		reader->start++;
+		return allocVector( VECSXP, 0 );
+	}
+	while( !done ) {
+		char c = peekJSONReader( reader );
+		if( c == '\0' )
+			return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete list\n" );
+		if( c != '"' )
+			return mkError(
+				"unexpected character \"%c\"; expecting opening string quote (\") for key value\n",
+				c );
+		if( ( err = frameJSONReader( reader ) ) != NULL )
+			return err;
+		key = parseStringChar( reader->buf + reader->start, &next_ch, parse_options );
+		if( TYPEOF( key ) != CHARSXP )
+			return key;
+		pushStringElement( arena, key );
+		reader->start = next_ch - reader->buf;
+
+		c = peekJSONReader( reader );
+		if( c != ':' ) {
+			if( c == '\0' )
+				return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete list - missing :\n" );
+			return mkError( "incomplete list - missing :\n" );
+		}
+		reader->start++;
+		if( peekJSONReader( reader ) == '\0' )
+			return mkErrorWithClass( INCOMPLETE_CLASS, "incomplete list\n" );
+
+		if( ( err = streamElement( reader, NULL, parse_options ) ) != NULL )
+			return err;
+		if( ( err = streamSeparator( reader, '}', &done ) ) != NULL )
+			return err;
+	}
+	return popList( parse_options, mark );
+}
+
+/* Parses a (possibly gzip or zstd compressed) JSON file. A schema describes either the top
+   level record, or each record of a top level array. */
+SEXP fromJSONFile( SEXP path, SEXP options, SEXP schema )
+{
+	SEXP ptr, p;
+	ParseArena arena;
+
+	ParseOptions parse_options;
+	readParseOptions( options, &parse_options );
+	parse_options.arena = &arena;
+
+	const JSONSchema* json_schema = schema == R_NilValue ? NULL : getJSONSchema( schema );
+
+	JSONReader* reader = allocJSONReader();
+	PROTECT( ptr = wrapJSONReader( reader ) );
+	openJSONReaderFile( reader, translateChar( STRING_ELT( path, 0 ) ) );
+
+	initParseArena( &arena );
+
+	char c = peekJSONReader( reader );
+	if( c == '[' ) {
+		p = streamArray( reader, json_schema, &parse_options );
+	}
+	else if( c == '{' && json_schema == NULL ) {
+		p = streamList( reader, &parse_options );
+	}
+	else {
+		/* scalars, and records parsed by a schema, are parsed in one go */
+		const char* next_ch;
+		p = frameJSONReader( reader );
+		if( p == NULL ) {
+			const char* s = reader->buf + reader->start;
+			if( json_schema )
+				p = parseSchemaValue( s, &next_ch, json_schema, &parse_options );
+			else
+				p = parseValue( s, &next_ch, &parse_options );
+			reader->start = next_ch - reader->buf;
+		}
+	}
+	PROTECT( p );
+
+	if( !hasClass( p, TRYERROR_CLASS ) && peekJSONReader( reader ) != '\0' )
+		p = mkError( "not all data was parsed\n" );
+
+	closeJSONReader( ptr );
+	UNPROTECT( 2 + PARSE_ARENA_PROTECT_COUNT );
+	return p;
+}
+
+/* Parses a (possibly compressed) file of newline delimited JSON documents, one line at a time.
+   Blank lines are skipped. invalid_na and data_frame are as for fromJSONVector. */
+SEXP fromNDJSON( SEXP path, SEXP options, SEXP schema, SEXP invalid_na, SEXP data_frame )
+{
+	int na_on_error = asLogical( invalid_na ) == TRUE;
+	int as_data_frame = asLogical( data_frame ) == TRUE;
+	SEXP ptr, results, p;
+	PROTECT_INDEX results_index;
+	R_xlen_t n = 0;
+	long long line_number = 0;
+	size_t scanned = 0; /* bytes after start known not to contain a newline */
+	ParseArena arena;
+
+	ParseOptions parse_options;
+	readParseOptions( options, &parse_options );
+	parse_options.arena = &arena;
+
+	const JSONSchema* json_schema = schema == R_NilValue ? NULL : getJSONSchema( schema );
+
+	JSONReader* reader = allocJSONReader();
+	PROTECT( ptr = wrapJSONReader( reader ) );
+	openJSONReaderFile( reader, translateChar( STRING_ELT( path, 0 ) ) );
+
+	initParseArena( &arena );
+	ParseArenaMark mark = markParseArena( &arena );
+
+	PROTECT_WITH_INDEX( results = allocVector( VECSXP, 1024 ), &results_index );
+	while( 1 ) {
+		char* line = reader->buf + reader->start;
+		char* end = memchr( line + scanned, '\n', reader->len - reader->start - scanned );
+		if( end == NULL && !reader->eof ) {
+			scanned = reader->len - reader->start;
+			fillJSONReaderFile( reader );
+			continue;
+		}
+		if( end == NULL && reader->start == reader->len )
+			break;
+		if( end == NULL )
+			end = reader->buf + reader->len;
+		scanned = 0;
+		line_number++;
+
+		/* parse the line in place */
+		char saved = *end;
+		*end = '\0';
+		const char* s = line;
+		while( *s == ' ' || *s == '\t' || *s == '\r' )
+			s++;
+		if( *s == '\0' ) {
+			*end = saved;
+			reader->start = end - reader->buf + ( saved == '\n' );
+			continue;
+		}
+		PROTECT( p = parseDocument( s, json_schema, &parse_options ) );
+		resetParseArena( &arena, mark );
+		*end = saved;
+		reader->start = end - reader->buf + ( saved == '\n' );
+
+		if( !hasClass( p, TRYERROR_CLASS ) && as_data_frame && !isRecord( p, s ) )
+			p = mkError( "not a JSON object" );
+		if( hasClass( p, TRYERROR_CLASS ) ) {
+			if( !na_on_error ) {
+				p = mkError( "line %lld: %s", line_number, CHAR( STRING_ELT( p, 0 ) ) );
+				closeJSONReader( ptr );
+				UNPROTECT( 3 + PARSE_ARENA_PROTECT_COUNT );
+				return p;
+			}
+			p = ScalarLogical( NA_LOGICAL );
+		}
+		if( n == XLENGTH( results ) )
+			REPROTECT( results = xlengthgets( results, 2 * n ), results_index );
+		SET_VECTOR_ELT( results, n++, p );
+		UNPROTECT( 1 ); /* p */
+	}
+	closeJSONReader( ptr );
+
+	REPROTECT( results = xlengthgets( results, n ), results_index );
+	if( as_data_frame )
+		REPROTECT( results = recordsToDataFrame( results ), results_index );
+
+	UNPROTECT( 2 + PARSE_ARENA_PROTECT_COUNT );
+	return results;
+}
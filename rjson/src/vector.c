@@ -0,0 +1,306 @@
+#include <R.h>
+#include <Rdefines.h>
+
+#include "funcs.h"
+#include "parser.h"
+
+/* how often the document loop checks for a user interrupt */
+#define INTERRUPT_CHECK_INTERVAL 4096
+
+/* value classes seen in a data.frame column */
+#define SEEN_LOGICAL 1
+#define SEEN_INTEGER 2
+#define SEEN_REAL 4
+#define SEEN_STRING 8
+#define SEEN_LIST 16
+#define SEEN_CLASSED 32 /* a scalar with a class, such as POSIXct or integer64 */
+
+/* parses a single complete document; anything other than whitespace after the value is an error */
+SEXP parseDocument( const char* s, const JSONSchema* json_schema, const ParseOptions* parse_options )
+{
+	const char* next_ch = s;
+	SEXP p;
+
+	if( json_schema )
+		PROTECT( p = parseSchemaValue( s, &next_ch, json_schema, parse_options ) );
+	else
+		PROTECT( p = parseValue( s, &next_ch, parse_options ) );
+
+	if( !hasClass( p, TRYERROR_CLASS ) ) {
+		while( *next_ch == ' ' || *next_ch == '\t' || *next_ch == '\n' || *next_ch == '\r' )
+			next_ch++;
+		if( *next_ch != '\0' )
+			p = mkError( "not all data was parsed (%d chars were parsed out of a total of %d chars)",
+						 (int)( next_ch - s ),
+						 (int)strlen( s ) );
+	}
+	UNPROTECT( 1 );
+	return p;
+}
+
+/* the records of a data.frame are JSON objects, which are parsed into (possibly empty) lists;
+   an empty list is only a record if its source text s is an object rather than an array */
+int isRecord( SEXP p, const char* s )
+{
+	if( TYPEOF( p ) != VECSXP )
+		return FALSE;
+	if( GET_NAMES( p ) != R_NilValue )
+		return TRUE;
+	while( *s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' )
+		s++;
+	return GET_LENGTH( p ) == 0 && *s == '{';
+}
+
+int getColumnClass( SEXP p )
+{
+	if( p == R_NilValue )
+		return 0;
+	if( GET_LENGTH( p ) != 1 )
+		return SEEN_LIST;
+	if( ATTRIB( p ) != R_NilValue ) {
+		if( GET_CLASS( p ) == R_NilValue || GET_NAMES( p ) != R_NilValue || GET_DIM( p ) != R_NilValue )
+			return SEEN_LIST;
+		switch( TYPEOF( p ) ) {
+		case LGLSXP:
+		case INTSXP:
+		case REALSXP:
+		case STRSXP:
+			return SEEN_CLASSED;
+		}
+		return SEEN_LIST;
+	}
+	switch( TYPEOF( p ) ) {
+	case LGLSXP:
+		return SEEN_LOGICAL;
+	case INTSXP:
+		return SEEN_INTEGER;
+	case REALSXP:
+		return SEEN_REAL;
+	case STRSXP:
+		return SEEN_STRING;
+	}
+	return SEEN_LIST;
+}
+
+/* TRUE when two classed scalars have the same type and class */
+int isSameColumnClass( SEXP p, SEXP q )
+{
+	SEXP p_class = GET_CLASS( p ), q_class = GET_CLASS( q );
+	if( TYPEOF( p ) != TYPEOF( q ) || XLENGTH( p_class ) != XLENGTH( q_class ) )
+		return FALSE;
+	for( R_xlen_t i = 0; i < XLENGTH( p_class ); i++ )
+		if( strcmp( CHAR( STRING_ELT( p_class, i ) ), CHAR( STRING_ELT( q_class, i ) ) ) != 0 )
+			return FALSE;
+	return TRUE;
+}
+
+/* the type of a column; a classed column has the type of its first value */
+SEXPTYPE getColumnType( int seen, SEXP first_classed )
+{
+	int has_number = ( seen & ( SEEN_INTEGER | SEEN_REAL ) ) != 0;
+	if( seen == SEEN_CLASSED )
+		return TYPEOF( first_classed );
+	if( seen & ( SEEN_LIST | SEEN_CLASSED ) )
+		return VECSXP;
+	if( ( ( seen & SEEN_LOGICAL ) != 0 ) + ( ( seen & SEEN_STRING ) != 0 ) + has_number > 1 )
+		return VECSXP;
+	if( seen & SEEN_STRING )
+		return STRSXP;
+	if( seen & SEEN_REAL )
+		return REALSXP;
+	if( seen & SEEN_INTEGER )
+		return INTSXP;
+	return LGLSXP;
+}
+
+/* Returns the column of a key, or -1. Records usually share their key order, so the column after
+   the previously matched one is tried before scanning every column. */
+R_xlen_t findColumn( SEXP names, R_xlen_t n_names, SEXP key, R_xlen_t hint )
+{
+	if( hint < n_names && STRING_ELT( names, hint ) == key )
+		return hint;
+	for( R_xlen_t i = 0; i < n_names; i++ )
+		if( STRING_ELT( names, i ) == key || strcmp( CHAR( STRING_ELT( names, i ) ), CHAR( key ) ) == 0 )
+			return i;
+	return -1;
+}
+
+/* Turns a list of records into a data.frame with a column per key, in order of first appearance.
+   Columns hold the simplest vector type able to store every value, with NA for missing keys,
+   nulls and rows which are not lists (documents which were not valid records); other columns are lists. Scalars with a class (such as
+   POSIXct or integer64) give a column with the attributes of the first one, if every value in
+   the column has the same class. */
+SEXP recordsToDataFrame( SEXP rows )
+{
+	R_xlen_t n_rows = XLENGTH( rows );
+	R_xlen_t n_names = 0, names_size = 16;
+	int* seen = (int*)R_alloc( names_size, sizeof( int ) );
+	SEXP* first_classed = (SEXP*)R_alloc( names_size, sizeof( SEXP ) );
+	SEXP names, df, column, row_names, classp;
+	PROTECT_INDEX names_index;
+
+	PROTECT_WITH_INDEX( names = allocVector( STRSXP, names_size ), &names_index );
+
+	/* collect the columns, and the classes of their values */
+	for( R_xlen_t i = 0; i < n_rows; i++ ) {
+		SEXP row = VECTOR_ELT( rows, i );
+		if( TYPEOF( row ) != VECSXP )
+			continue;
+		SEXP keys = GET_NAMES( row );
+		R_xlen_t hint = 0;
+		for( R_xlen_t j = 0; j < XLENGTH( row ); j++ ) {
+			SEXP key = STRING_ELT( keys, j );
+			R_xlen_t c = findColumn( names, n_names, key, hint );
+			if( c < 0 ) {
+				if( n_names == names_size ) {
+					int* new_seen = (int*)R_alloc( 2 * names_size, sizeof( int ) );
+					SEXP* new_first_classed = (SEXP*)R_alloc( 2 * names_size, sizeof( SEXP ) );
+					memcpy( new_seen, seen, names_size * sizeof( int ) );
+					memcpy( new_first_classed, first_classed, names_size * sizeof( SEXP ) );
+					seen = new_seen;
+					first_classed = new_first_classed;
+					names_size *= 2;
+					REPROTECT( names = xlengthgets( names, names_size ), names_index );
+				}
+				SET_STRING_ELT( names, n_names, key );
+				seen[n_names] = 0;
+				first_classed[n_names] = R_NilValue;
+				c = n_names++;
+			}
+			/* the values are protected by rows, so the first classed one is kept unprotected */
+			SEXP value = VECTOR_ELT( row, j );
+			int value_class = getColumnClass( value );
+			if( value_class == SEEN_CLASSED ) {
+				if( first_classed[c] == R_NilValue )
+					first_classed[c] = value;
+				else if( !isSameColumnClass( first_classed[c], value ) )
+					value_class = SEEN_LIST;
+			}
+			seen[c] |= value_class;
+			hint = c + 1;
+		}
+	}
+
+	PROTECT( df = allocVector( VECSXP, n_names ) );
+	for( R_xlen_t c = 0; c < n_names; c++ ) {
+		SEXPTYPE type = getColumnType( seen[c], first_classed[c] );
+		int is_integer64 = FALSE;
+		SET_VECTOR_ELT( df, c, column = allocVector( type, n_rows ) );
+		if( seen[c] == SEEN_CLASSED ) {
+			for( SEXP a = ATTRIB( first_classed[c] ); a != R_NilValue; a = CDR( a ) )
+				setAttrib( column, TAG( a ), CAR( a ) );
+			is_integer64 = inherits( column, "integer64" );
+		}
+		for( R_xlen_t i = 0; i < n_rows; i++ )
+			setNAElement( column, i, is_integer64 );
+	}
+
+	for( R_xlen_t i = 0; i < n_rows; i++ ) {
+		SEXP row = VECTOR_ELT( rows, i );
+		if( TYPEOF( row ) != VECSXP )
+			continue;
+		SEXP keys = GET_NAMES( row );
+		R_xlen_t hint = 0;
+		for( R_xlen_t j = 0; j < XLENGTH( row ); j++ ) {
+			SEXP value = VECTOR_ELT( row, j );
+			R_xlen_t c = findColumn( names, n_names, STRING_ELT( keys, j ), hint );
+			hint = c + 1;
+			if( value == R_NilValue )
+				continue;
+			column = VECTOR_ELT( df, c );
+			switch( TYPEOF( column ) ) {
+			case LGLSXP:
+				LOGICAL( column )[i] = LOGICAL( value )[0];
+				break;
+			case INTSXP:
+				INTEGER( column )[i] = INTEGER( value )[0];
+				break;
+			case REALSXP:
+				if( TYPEOF( value ) == REALSXP )
+					REAL( column )[i] = REAL( value )[0];
+				else if( INTEGER( value )[0] != NA_INTEGER )
+					REAL( column )[i] = INTEGER( value )[0];
+				break;
+			case STRSXP:
+				SET_STRING_ELT( column, i, STRING_ELT( value, 0 ) );
+				break;
+			default:
+				SET_VECTOR_ELT( column, i, value );
+			}
+		}
+	}
+
+	REPROTECT( names = xlengthgets( names, n_names ), names_index );
+	setAttrib( df, R_NamesSymbol, names );
+
+	/* compact row names: c(NA, -n) */
+	PROTECT( row_names = allocVector( INTSXP, 2 ) );
+	INTEGER( row_names )[0] = NA_INTEGER;
+	INTEGER( row_names )[1] = -(int)n_rows;
+	setAttrib( df, R_RowNamesSymbol, row_names );
+
+	PROTECT( classp = mkString( "data.frame" ) );
+	SET_CLASS( df, classp );
+
+	UNPROTECT( 4 );
+	return df;
+}
+
+/* Parses every element of a character vector, sharing one arena between the documents.
+   NA elements give NA. Invalid documents give NA when invalid_na is TRUE, otherwise the first
+   error is returned (as a try-error) instead of the results. */
+SEXP fromJSONVector( SEXP str_in, SEXP options, SEXP schema, SEXP invalid_na, SEXP data_frame )
+{
+	R_xlen_t n = XLENGTH( str_in );
+	int na_on_error = asLogical( invalid_na ) == TRUE;
+	int as_data_frame = asLogical( data_frame ) == TRUE;
+	SEXP results, p;
+	ParseArena arena;
+
+	ParseOptions parse_options;
+	readParseOptions( options, &parse_options );
+	parse_options.arena = &arena;
+
+	const JSONSchema* json_schema = schema == R_NilValue ? NULL : getJSONSchema( schema );
+
+	if( as_data_frame && n > INT_MAX )
+		Rf_error( "too many documents for a data.frame" );
+
+	initParseArena( &arena );
+	ParseArenaMark mark = markParseArena( &arena );
+
+	PROTECT( results = allocVector( VECSXP, n ) );
+	for( R_xlen_t i = 0; i < n; i++ ) {
+		if( i % INTERRUPT_CHECK_INTERVAL == 0 )
+			R_CheckUserInterrupt();
+
+		SEXP s = STRING_ELT( str_in, i );
+		if( s == NA_STRING ) {
+			SET_VECTOR_ELT( results, i, ScalarLogical( NA_LOGICAL ) );
+			continue;
+		}
+
+		PROTECT( p = parseDocument( CHAR( s ), json_schema, &parse_options ) );
+		/* errors can leave a partially built container on the stacks */
+		resetParseArena( &arena, mark );
+
+		if( !hasClass( p, TRYERROR_CLASS ) && as_data_frame && !isRecord( p, CHAR( s ) ) )
+			p = mkError( "not a JSON object" );
+		if( hasClass( p, TRYERROR_CLASS ) ) {
+			if( !na_on_error ) {
+				p = mkError( "element %lld: %s", (long long)i + 1, CHAR( STRING_ELT( p, 0 ) ) );
+				UNPROTECT( 2 + PARSE_ARENA_PROTECT_COUNT );
+				return p;
+			}
+			p = ScalarLogical( NA_LOGICAL );
+		}
+		SET_VECTOR_ELT( results, i, p );
+		UNPROTECT( 1 ); /* p */
+	}
+
+	if( as_data_frame )
+		results = recordsToDataFrame( results );
+
+	UNPROTECT( 1 + PARSE_ARENA_PROTECT_COUNT );
+	return results;
+}